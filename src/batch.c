@@ -0,0 +1,305 @@
+// fork/socketpair/mmap compartido necesitan las extensiones POSIX
+#define _GNU_SOURCE
+#include "batch.h"
+#include "record.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BATCH_POSIX 1
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+enum
+{
+    BOP_UPDATE = 1, // simular el frame k en t; responde el objetivo del centrado
+    BOP_RENDER,     // dibujar el frame ya simulado con el (tx, ty) definitivo
+    BOP_QUIT
+};
+
+typedef struct
+{
+    int op;
+    long k;
+    float t;
+    float tx, ty;
+} BatchCmd;
+
+typedef struct
+{
+    float tx_target, ty_target;
+    double ms;
+} BatchReply;
+
+#ifdef BATCH_POSIX
+static int write_full(int fd, const void *buf, size_t n)
+{
+    const char *p = (const char *)buf;
+    while (n > 0)
+    {
+        ssize_t k = send(fd, p, n, MSG_NOSIGNAL);
+        if (k < 0 && errno == EINTR)
+            continue;
+        if (k <= 0)
+            return 0;
+        p += k;
+        n -= (size_t)k;
+    }
+    return 1;
+}
+
+static int read_full(int fd, void *buf, size_t n)
+{
+    char *p = (char *)buf;
+    while (n > 0)
+    {
+        ssize_t k = read(fd, p, n);
+        if (k < 0 && errno == EINTR)
+            continue;
+        if (k <= 0)
+            return 0;
+        p += k;
+        n -= (size_t)k;
+    }
+    return 1;
+}
+
+// El framebuffer del trabajador vive en la memoria compartida: el
+// coordinador lo copia al grabador sin pasar los píxeles por el socket.
+static void worker_main(const ClothParams *P, int W, int H, unsigned char *fb, int w, int fd, int threads)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#else
+    (void)threads;
+#endif
+    SDL_Surface *surf = SDL_CreateRGBSurfaceWithFormatFrom(fb, W, H, 32, W * 4, SDL_PIXELFORMAT_RGBA32);
+    SDL_Renderer *R = surf ? SDL_CreateSoftwareRenderer(surf) : NULL;
+    ClothState S;
+    if (!R || cloth_init(R, &S, P, W, H) != 0)
+    {
+        fprintf(stderr, "batch: trabajador %d no pudo inicializarse\n", w);
+        _exit(1);
+    }
+
+    BatchCmd cmd;
+    while (read_full(fd, &cmd, sizeof(cmd)) && cmd.op != BOP_QUIT)
+    {
+        BatchReply rep;
+        memset(&rep, 0, sizeof(rep));
+        const Uint64 t0 = SDL_GetPerformanceCounter();
+        if (cmd.op == BOP_UPDATE)
+        {
+            cloth_update(R, &S, W, H, cmd.t);
+            rep.tx_target = S.tx_target;
+            rep.ty_target = S.ty_target;
+        }
+        else if (cmd.op == BOP_RENDER)
+        {
+            S.tx = cmd.tx;
+            S.ty = cmd.ty;
+            SDL_SetRenderDrawColor(R, 0, 0, 0, 255);
+            SDL_RenderClear(R);
+            cloth_render_seq(R, &S);
+            SDL_RenderFlush(R);
+        }
+        rep.ms = 1000.0 * (double)(SDL_GetPerformanceCounter() - t0) / (double)SDL_GetPerformanceFrequency();
+        if (!write_full(fd, &rep, sizeof(rep)))
+            break;
+    }
+    cloth_destroy(&S);
+    SDL_DestroyRenderer(R);
+    SDL_FreeSurface(surf);
+    _exit(0);
+}
+
+static void stop_workers(const pid_t *pid, const int *fd, int M)
+{
+    const BatchCmd cmd = {BOP_QUIT, 0, 0.f, 0.f, 0.f};
+    for (int w = 0; w < M; ++w)
+        if (pid[w] > 0)
+        {
+            write_full(fd[w], &cmd, sizeof(cmd));
+            close(fd[w]);
+        }
+    for (int w = 0; w < M; ++w)
+        if (pid[w] > 0)
+            waitpid(pid[w], NULL, 0);
+}
+#endif
+
+int batch_run(const ClothParams *P, int W, int H, long frames, int fps, int workers, int threads_total,
+              const char *path, int slots)
+{
+#ifdef BATCH_POSIX
+    const int M = workers;
+    if (M < 1 || frames <= 0 || W <= 1 || H <= 1 || !path)
+    {
+        fprintf(stderr, "batch: se necesitan M >= 1, --frames F > 0 y --record FILE\n");
+        return 1;
+    }
+    if (fps <= 0)
+        fps = 60;
+    const size_t fb_bytes = (size_t)W * (size_t)H * 4;
+    unsigned char *shm = (unsigned char *)mmap(NULL, (size_t)M * fb_bytes, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shm == MAP_FAILED)
+    {
+        fprintf(stderr, "batch: mmap de %.1f MB falló\n", (double)((size_t)M * fb_bytes) / 1048576.0);
+        return 1;
+    }
+    pid_t *pid = (pid_t *)calloc((size_t)M, sizeof(pid_t));
+    int *fd = (int *)malloc((size_t)M * sizeof(int));
+    int (*sp)[2] = (int (*)[2])malloc((size_t)M * sizeof(*sp));
+    if (!pid || !fd || !sp)
+    {
+        free(pid);
+        free(fd);
+        free(sp);
+        munmap(shm, (size_t)M * fb_bytes);
+        return 1;
+    }
+    int nsp = 0;
+    while (nsp < M && socketpair(AF_UNIX, SOCK_STREAM, 0, sp[nsp]) == 0)
+        nsp++;
+    if (nsp < M)
+    {
+        fprintf(stderr, "batch: socketpair: %s\n", strerror(errno));
+        for (int k = 0; k < nsp; ++k)
+        {
+            close(sp[k][0]);
+            close(sp[k][1]);
+        }
+        free(pid);
+        free(fd);
+        free(sp);
+        munmap(shm, (size_t)M * fb_bytes);
+        return 1;
+    }
+
+    // Frames independientes: conviene un hilo por trabajador y más trabajadores
+    int per = threads_total / M;
+    if (per < 1)
+        per = 1;
+    fflush(NULL); // el hijo no debe repetir lo que quedó en los buffers de stdio
+    for (int w = 0; w < M; ++w)
+    {
+        pid[w] = fork();
+        if (pid[w] == 0)
+        {
+            for (int k = 0; k < M; ++k)
+            {
+                close(sp[k][0]);
+                if (k != w)
+                    close(sp[k][1]);
+            }
+            worker_main(P, W, H, shm + (size_t)w * fb_bytes, w, sp[w][1], per);
+        }
+        if (pid[w] < 0)
+            fprintf(stderr, "batch: fork: %s\n", strerror(errno));
+    }
+    int ok = 1;
+    for (int w = 0; w < M; ++w)
+    {
+        close(sp[w][1]);
+        fd[w] = sp[w][0];
+        if (pid[w] <= 0)
+            ok = 0;
+    }
+    free(sp);
+
+    // El coordinador solo necesita el timer y el hilo escritor del grabador
+    Recorder *rec = NULL;
+    if (ok && SDL_Init(SDL_INIT_TIMER) == 0)
+        rec = rec_open(path, W, H, fps, slots);
+    rec_set_blocking(rec, 1);
+    if (ok && rec)
+        printf("batch: %ld frames %dx%d a %d fps, %d trabajadores x %d hilos\n", frames, W, H, fps, M, per);
+
+    // Cada trabajador tiene a lo sumo un frame en vuelo (el k con k % M == w).
+    // Por frame: UPDATE -> objetivo del centrado; el coordinador aplica la EMA
+    // en orden y manda RENDER con el tx/ty definitivo; al terminar, el frame
+    // se copia al grabador y el trabajador recibe su próximo UPDATE, que no
+    // toca el framebuffer y se solapa con la copia.
+    const Uint64 t0 = SDL_GetPerformanceCounter();
+    float tx = 0.f, ty = 0.f; // como cloth_init: el centrado arranca en 0
+    double upd_ms = 0.0, ren_ms = 0.0;
+    long next_upd = 0, next_tx = 0, next_out = 0;
+    for (int w = 0; ok && rec && w < M && next_upd < frames; ++w, ++next_upd)
+    {
+        const BatchCmd cmd = {BOP_UPDATE, next_upd, (float)next_upd / (float)fps, 0.f, 0.f};
+        ok = write_full(fd[w], &cmd, sizeof(cmd));
+    }
+    while (ok && rec && next_out < frames)
+    {
+        BatchReply rep;
+        for (; ok && next_tx < next_upd; ++next_tx)
+        {
+            const int w = (int)(next_tx % M);
+            ok = read_full(fd[w], &rep, sizeof(rep));
+            if (!ok)
+                break;
+            upd_ms += rep.ms;
+            cloth_center_step(&tx, &ty, rep.tx_target, rep.ty_target);
+            const BatchCmd cmd = {BOP_RENDER, next_tx, 0.f, tx, ty};
+            ok = write_full(fd[w], &cmd, sizeof(cmd));
+        }
+        const int w = (int)(next_out % M);
+        if (!ok || !read_full(fd[w], &rep, sizeof(rep)))
+        {
+            ok = 0;
+            break;
+        }
+        ren_ms += rep.ms;
+        if (next_upd < frames)
+        {
+            const BatchCmd cmd = {BOP_UPDATE, next_upd, (float)next_upd / (float)fps, 0.f, 0.f};
+            ok = write_full(fd[w], &cmd, sizeof(cmd));
+            next_upd++;
+        }
+        rec_capture_pixels(rec, shm + (size_t)w * fb_bytes, W * 4, W, H);
+        next_out++;
+    }
+    const double secs = (double)(SDL_GetPerformanceCounter() - t0) / (double)SDL_GetPerformanceFrequency();
+    if (!ok)
+        fprintf(stderr, "batch: un trabajador dejo de responder (frame %ld)\n", next_out);
+
+    stop_workers(pid, fd, M);
+    if (rec)
+        rec_close(rec);
+    if (next_out > 0)
+        printf("batch: %ld frames en %.2f s (%.1f fps) | por frame: update %.2f ms, render %.2f ms\n", next_out,
+               secs, (double)next_out / secs, upd_ms / (double)next_out, ren_ms / (double)next_out);
+    SDL_Quit();
+    free(pid);
+    free(fd);
+    munmap(shm, (size_t)M * fb_bytes);
+    return (ok && rec && next_out == frames) ? 0 : 1;
+#else
+    (void)P;
+    (void)W;
+    (void)H;
+    (void)frames;
+    (void)fps;
+    (void)workers;
+    (void)threads_total;
+    (void)path;
+    (void)slots;
+    fprintf(stderr, "batch: --batch requiere un sistema POSIX (fork/socketpair)\n");
+    return 1;
+#endif
+}
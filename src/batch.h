@@ -0,0 +1,29 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "cloth.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Render offline por lotes (--batch M). La tela es función de t, así que
+    // los frames son independientes: M procesos trabajadores (fork) tienen cada
+    // uno su ClothState y su framebuffer por software en memoria compartida y
+    // se reparten los frames en round-robin. Lo único que encadena frames es
+    // el centrado suavizado: cada trabajador informa el objetivo del centrado
+    // de su frame y el coordinador aplica la EMA en orden, de modo que tx/ty
+    // son exactamente los de una corrida secuencial. Los frames terminados se
+    // escriben en orden con el grabador (video o un PPM por frame).
+
+    // Debe llamarse antes de SDL_Init y de cualquier región OpenMP: hace fork.
+    // Renderiza 'frames' frames en t = k / fps a W x H y los escribe en path.
+    // threads_total se reparte entre los trabajadores. Devuelve 0 si terminó.
+    int batch_run(const ClothParams *P, int W, int H, long frames, int fps, int workers, int threads_total,
+                  const char *path, int slots);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,86 @@
+#ifndef BUFRING_H
+#define BUFRING_H
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Anillo SPSC (un productor, un consumidor) de buffers preasignados.
+// El productor (hilo de render) nunca se bloquea: si no hay slot libre,
+// bufring_acquire devuelve NULL y el llamador decide descartar el dato.
+// head solo lo escribe el productor y tail solo el consumidor.
+typedef struct
+{
+    unsigned char *mem; // bloque contiguo con todos los slots
+    size_t slot_bytes;
+    unsigned count;
+    atomic_uint head; // próximo slot a publicar
+    atomic_uint tail; // próximo slot a consumir
+} BufRing;
+
+static inline int bufring_init(BufRing *q, unsigned count, size_t slot_bytes)
+{
+    memset(q, 0, sizeof(*q));
+    if (count == 0 || slot_bytes == 0)
+        return 0;
+    q->mem = (unsigned char *)malloc(slot_bytes * count);
+    if (!q->mem)
+        return 0;
+    // Primer toque: evita page faults en el hilo de render durante la captura
+    memset(q->mem, 0, slot_bytes * count);
+    q->slot_bytes = slot_bytes;
+    q->count = count;
+    atomic_init(&q->head, 0u);
+    atomic_init(&q->tail, 0u);
+    return 1;
+}
+
+static inline void bufring_free(BufRing *q)
+{
+    free(q->mem);
+    q->mem = NULL;
+    q->count = 0;
+}
+
+// Productor: slot libre o NULL si el anillo está lleno
+static inline unsigned char *bufring_acquire(BufRing *q)
+{
+    unsigned h = atomic_load_explicit(&q->head, memory_order_relaxed);
+    unsigned t = atomic_load_explicit(&q->tail, memory_order_acquire);
+    if (h - t >= q->count)
+        return NULL;
+    return q->mem + (size_t)(h % q->count) * q->slot_bytes;
+}
+
+// Productor: publica el slot obtenido con bufring_acquire
+static inline void bufring_publish(BufRing *q)
+{
+    unsigned h = atomic_load_explicit(&q->head, memory_order_relaxed);
+    atomic_store_explicit(&q->head, h + 1u, memory_order_release);
+}
+
+// Consumidor: slot más antiguo pendiente o NULL si está vacío
+static inline unsigned char *bufring_peek(BufRing *q)
+{
+    unsigned t = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned h = atomic_load_explicit(&q->head, memory_order_acquire);
+    if (h == t)
+        return NULL;
+    return q->mem + (size_t)(t % q->count) * q->slot_bytes;
+}
+
+// Consumidor: devuelve el slot al productor
+static inline void bufring_release(BufRing *q)
+{
+    unsigned t = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    atomic_store_explicit(&q->tail, t + 1u, memory_order_release);
+}
+
+// Número de slots en cola (aproximado si se llama desde otro hilo)
+static inline unsigned bufring_size(BufRing *q)
+{
+    return atomic_load_explicit(&q->head, memory_order_acquire) -
+           atomic_load_explicit(&q->tail, memory_order_acquire);
+}
+
+#endif
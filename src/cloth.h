@@ -26,6 +26,10 @@ extern "C"
         float panX_px;      // Paneo X (px)
         float panY_px;      // Paneo Y (px)
         int autoCenter;     // 1 = centrar automáticamente (default)
+        int bandY0, bandY1; // franja de filas [Y0, Y1) de la malla GX x GY (0,0 = completa)
+        int sortedDraw;     // 1 = el scatter copia draw en orden de dibujo (ClothState.sorted)
+        int keepOrder;      // con sortedDraw: escribir también order_idx (quien lo lea)
+        int palette;        // >0: el render secuencial cuantiza a ~palette colores y agrupa por bin
     } ClothParams;
 
     typedef struct
@@ -33,30 +37,76 @@ extern "C"
         ClothParams P;
         int W_last, H_last;
         // Número total de partículas
-        int N;
+        size_t N;
+        // Esferas cuyo disco tocaba el área W x H en el último update (se
+        // cuentan en el kernel de update, con el paneo del frame anterior)
+        size_t visible;
 
         // Arreglo de elementos para dibujar
         DrawItem *draw;
-        // Arreglo de profundidades
-        float *depth;
-        // Orden final y capacidad reservada
+        // Clave de profundidad por esfera (16 bits, crece con z)
+        uint16_t *depth;
+        // Capacidad de draw/depth (>= N); cloth_reserve la adelanta
+        size_t draw_cap;
+        // Orden final y capacidad reservada. Índices de 32 bits a propósito
+        // (4 B/esfera): N está acotado a INT_MAX (cloth_init, cloth_reserve y
+        // cloth_resize rechazan grillas mayores).
         int *order_idx;
-        int order_cap;
+        size_t order_cap;
+        // Con P.sortedDraw: draw ya en orden de dibujo; los backends lo
+        // recorren en forma lineal en vez de draw[order_idx[q]]. NULL si no.
+        DrawItem *sorted;
+        size_t sorted_cap;
+        // Inicio de cada bin de profundidad en el orden de dibujo (nbins
+        // entradas); NULL si el orden no viene del bucket sort de este estado
+        const size_t *bin_start;
+        int nbins;
 
         // Sprite circular (textura) y radio en px
         SDL_Texture *sprite;
         int spriteRadius;
 
         float tx, ty; // offset de paneo/centrado (suavizado)
+        // Objetivo del centrado en el último update: solo depende de t, así
+        // que la secuencia de tx/ty se puede reproducir fuera de orden
+        float tx_target, ty_target;
+
+        // Cambio de grilla pendiente (cloth_resize): next_row filas de la
+        // malla nueva ya construidas (negativo: faltan etapas de reserva).
+        // next_GX == 0 si no hay ninguno.
+        int next_GX, next_GY, next_row;
+        float next_radius;
     } ClothState;
 
     // Inicialización de la tela
     int cloth_init(SDL_Renderer *R, ClothState *S, const ClothParams *P_in, int W, int H);
+    // cloth_init en dos fases para arrancar en paralelo con la ventana:
+    // cloth_init_buffers no toca SDL (buffers con primer toque en paralelo,
+    // malla y píxeles del sprite) y puede correr en otro hilo;
+    // cloth_init_finish crea la textura del sprite en el hilo de SDL.
+    int cloth_init_buffers(ClothState *S, const ClothParams *P_in, int W, int H);
+    int cloth_init_finish(SDL_Renderer *R, ClothState *S);
     // Calcula posiciones proyecta
     void cloth_update(SDL_Renderer *R, ClothState *S, int W, int H, float t);
     // Liberación de recursos
     void cloth_destroy(ClothState *S);
 
+    // Cambio de grilla en vivo. cloth_resize solo lo deja pendiente: los
+    // cloth_update siguientes arman la malla nueva por tramos (en paralelo)
+    // sin dejar de simular la actual, y en el frame en que está completa la
+    // adoptan. radius <= 0 reescala el radio base con el tamaño de celda.
+    // Devuelve 1 si quedó pendiente, 0 si la grilla ya era esa, -1 si no aplica.
+    int cloth_resize(ClothState *S, int GX, int GY, float radius);
+    int cloth_resize_pending(const ClothState *S);
+    // Reserva (y toca) de una vez los buffers para hasta maxN esferas: un
+    // cambio de grilla dentro de ese tamaño no reserva memoria en el frame.
+    int cloth_reserve(ClothState *S, size_t maxN);
+    // Un paso de la EMA del centrado (la misma que aplica cloth_update)
+    void cloth_center_step(float *tx, float *ty, float tx_target, float ty_target);
+    // Recrea el sprite si el radio base cambió. cloth_update lo hace solo si
+    // recibe el renderer; llamar desde el hilo de SDL.
+    int cloth_sync_sprite(SDL_Renderer *R, ClothState *S);
+
     // Backends de dibujo
     void cloth_render_seq(SDL_Renderer *R, const ClothState *S);
     // Prepara la geometria en paralelo y si falla se usa secuencial
@@ -64,6 +114,69 @@ extern "C"
     // Liberación de recursos
     void cloth_draw_omp_release(void);
 
+#ifdef _OPENMP
+    // Variante como grafo de tareas (ver taskgraph.h): agregan sus tareas al
+    // grafo G sin ejecutarlas. cloth_update_graph devuelve la tarea final del
+    // update y llena 'deps' con una tarea por tramo de posiciones del orden de
+    // dibujo; cloth_render_graph hace depender la geometría de cada chunk solo
+    // de los tramos que lee y deja el envío a SDL en tareas TG_MAIN. Devuelven
+    // -1 si no se pudo armar (con deps->n = 0 la geometría no espera a nadie).
+#define CLOTH_TG_RANGES 4
+    typedef struct TaskGraph TaskGraph;
+    typedef struct
+    {
+        int n;       // tramos
+        size_t span; // posiciones por tramo: el tramo r es [r*span, (r+1)*span)
+        int dep[CLOTH_TG_RANGES];
+    } ClothGraphDeps;
+    int cloth_update_graph(TaskGraph *G, SDL_Renderer *R, ClothState *S, int W, int H, float t,
+                           ClothGraphDeps *deps);
+    int cloth_render_graph(TaskGraph *G, SDL_Renderer *R, const ClothState *S, const ClothGraphDeps *deps);
+#endif
+
+    // Interpolación entre dos estados de simulación (simulación a tasa fija,
+    // render a la tasa del display). Los buffers de draw rotan con el estado
+    // para no copiar: tras cada cloth_update, cloth_interp_push se queda con
+    // S->draw/S->depth/S->order_idx y le entrega a S buffers libres, así que
+    // el próximo cloth_update puede correr en otro hilo (ClothSim) mientras
+    // se dibuja la vista.
+    typedef struct
+    {
+        DrawItem *prev_draw, *curr_draw; // estados en prev_t y curr_t
+        uint16_t *prev_depth, *curr_depth;
+        float prev_tx, prev_ty, curr_tx, curr_ty;
+        double prev_t, curr_t;
+        int nstates; // 0, 1 o 2 estados válidos
+        size_t N, cap;
+        size_t state_cap; // capacidad de prev/curr: sigue a S->draw_cap
+
+        int *curr_order; // order_idx del estado en curr_t
+        size_t curr_order_cap;
+
+        DrawItem *out; // resultado interpolado (lo consume el render)
+        uint16_t *out_depth;
+        int *order;   // curr_order reparado con la profundidad interpolada
+        uint8_t *bin; // bins de la clave interpolada (solo al rehacer el orden)
+        long rebins;  // vistas en que las claves derivaron más de un bin y se rehízo el orden
+    } ClothInterp;
+
+    // Registra el estado recién simulado en el instante t
+    int cloth_interp_push(ClothInterp *I, ClothState *S, double t);
+    // Construye en *view un estado listo para cloth_render_* en el instante t.
+    // De S solo se toman parámetros y sprite: draw, profundidad y orden salen
+    // de los estados registrados (S puede ser una copia tomada tras el push).
+    void cloth_interp_view(ClothInterp *I, const ClothState *S, double t, ClothState *view);
+    void cloth_interp_release(ClothInterp *I);
+
+    // Hilo de simulación para --simhz: corre cloth_update(NULL, S, ...) fuera
+    // del hilo de render. Entre cloth_sim_kick y cloth_sim_wait el hilo es
+    // dueño de S; el sprite se sincroniza después en el hilo de SDL.
+    typedef struct ClothSim ClothSim;
+    ClothSim *cloth_sim_start(ClothState *S);
+    void cloth_sim_kick(ClothSim *M, int W, int H, float t, int threads);
+    void cloth_sim_wait(ClothSim *M);
+    void cloth_sim_stop(ClothSim *M);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,117 +1,23 @@
 #include "cloth.h"
+#include "cloth_math.h"
+#include "cloth_kernels.h"
+#include "perfcount.h"
+#include "trace.h"
 #include <math.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-
 #ifdef _OPENMP
 #include <omp.h>
+#include "taskgraph.h"
 #endif
 
-#ifndef LIKELY
-#define LIKELY(x) __builtin_expect(!!(x), 1)
-#define UNLIKELY(x) __builtin_expect(!!(x), 0)
-#endif
-
-// Funciones auxiliares: clamp rápido y conversión HSV a RGB para paletas suaves
-static inline float clampf(float v, float a, float b) { return fminf(fmaxf(v, a), b); }
-
-static inline void hsv_to_rgb(float h, float s, float v,
-                              unsigned char *R, unsigned char *G, unsigned char *B)
-{
-    h -= floorf(h);      // hue envuelto a [0, 1)
-    float hf = h * 6.0f; // 6 sectores
-    int i = (int)floorf(hf);
-    float f = hf - (float)i;
-    float p = v * (1.0f - s);
-    float q = v * (1.0f - f * s);
-    float t = v * (1.0f - (1.0f - f) * s);
-    float r, g, b;
-    // Esto sirve para interpolación de colores
-    switch (i % 6)
-    {
-    case 0:
-        r = v;
-        g = t;
-        b = p;
-        break;
-    case 1:
-        r = q;
-        g = v;
-        b = p;
-        break;
-    case 2:
-        r = p;
-        g = v;
-        b = t;
-        break;
-    case 3:
-        r = p;
-        g = q;
-        b = v;
-        break;
-    case 4:
-        r = t;
-        g = p;
-        b = v;
-        break;
-    default:
-        r = v;
-        g = p;
-        b = q;
-        break;
-    }
-    r = clampf(r, 0.f, 1.f);
-    g = clampf(g, 0.f, 1.f);
-    b = clampf(b, 0.f, 1.f);
-    *R = (unsigned char)(r * 255.f);
-    *G = (unsigned char)(g * 255.f);
-    *B = (unsigned char)(b * 255.f);
-}
-
-// Tipos simples para 3D/2D y rotaciones elementales
-typedef struct
-{
-    float x, y, z;
-} Vec3;
-typedef struct
-{
-    float x, y;
-} Vec2;
-
-static inline Vec3 rotX(Vec3 v, float ang)
-{
-    float c = cosf(ang), s = sinf(ang);
-    Vec3 r;
-    r.x = v.x;
-    r.y = v.y * c - v.z * s;
-    r.z = v.y * s + v.z * c;
-    return r;
-}
-static inline Vec3 rotY(Vec3 v, float ang)
-{
-    float c = cosf(ang), s = sinf(ang);
-    Vec3 r;
-    r.x = v.x * c + v.z * s;
-    r.y = v.y;
-    r.z = -v.x * s + v.z * c;
-    return r;
-}
-
-// Proyección perspectiva con protección frente a denominadores casi cero
-static inline Vec2 project_point(Vec3 v, int W, int H, float fov, float zCam)
-{
-    float denom = (v.z - zCam);
-    if (UNLIKELY(fabsf(denom) < 1e-4f))
-        denom = (denom >= 0.f ? 1e-4f : -1e-4f);
-    float scale = fov / denom;
-    float hw = 0.5f * (float)W, hh = 0.5f * (float)H;
-    Vec2 out = {v.x * scale * hw + hw, v.y * scale * hh + hh};
-    return out;
-}
+// Sprite ya rasterizado por cloth_init_buffers (fuera del hilo de SDL);
+// make_circle_sprite lo sube si el radio coincide y lo libera.
+static Uint32 *g_sprite_px = NULL;
+static int g_sprite_px_radius = 0;
 
 // Genera un sprite ARGB8888 estático con alpha suave y un highlight leve.
 // Se crea en CPU y se sube a la textura con SDL_UpdateTexture.
@@ -124,31 +30,25 @@ static SDL_Texture *make_circle_sprite(SDL_Renderer *R, int radius)
         return NULL;
     SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
 
-    // buffer CPU temporal
+    // buffer CPU temporal (o el que dejó listo cloth_init_buffers)
     const int pitch = d * (int)sizeof(Uint32);
-    Uint32 *buf = (Uint32 *)malloc((size_t)pitch * d);
+    Uint32 *buf = (g_sprite_px && g_sprite_px_radius == radius) ? g_sprite_px : NULL;
     if (!buf)
     {
-        SDL_DestroyTexture(tex);
-        return NULL;
-    }
-
-    for (int y = 0; y < d; ++y)
-    {
-        Uint32 *row = buf + y * d;
-        for (int x = 0; x < d; ++x)
+        buf = (Uint32 *)malloc((size_t)pitch * d);
+        if (!buf)
         {
-            float dx = (x + 0.5f - radius), dy = (y + 0.5f - radius);
-            float r = sqrtf(dx * dx + dy * dy) / (float)radius; // 0..1
-            float alpha = clampf(1.0f - r * r, 0.0f, 1.0f);     // borde suave
-            float sx = (dx + dy * 0.3f) / (float)radius;
-            float spec = clampf(0.9f - (sx * sx + dy * dy / (radius * radius)) * 1.2f, 0.0f, 1.0f) * 0.3f;
-            Uint8 A = (Uint8)(alpha * 255.f);
-            Uint8 c = (Uint8)(spec * 255.f);
-            row[x] = (A << 24) | (c << 16) | (c << 8) | c; // ARGB
+            SDL_DestroyTexture(tex);
+            return NULL;
         }
+        cloth_kernels()->sprite(buf, radius);
     }
     SDL_UpdateTexture(tex, NULL, buf, pitch);
+    if (buf == g_sprite_px)
+    {
+        g_sprite_px = NULL;
+        g_sprite_px_radius = 0;
+    }
     free(buf);
     return tex;
 }
@@ -157,7 +57,7 @@ static SDL_Texture *make_circle_sprite(SDL_Renderer *R, int radius)
 // g_X/g_Y: malla base en mundo.
 // Bucketing: índices de bin y arreglos auxiliares
 static float *g_X = NULL, *g_Y = NULL;
-static int g_xy_cap = 0;
+static size_t g_xy_cap = 0;
 static int g_last_GX = 0, g_last_GY = 0;
 static float g_last_spanX = 0.f, g_last_spanY = 0.f;
 
@@ -165,62 +65,84 @@ static float g_last_spanX = 0.f, g_last_spanY = 0.f;
 // El bucketing es una técnica para agrupar partículas en "bins" o contenedores
 // según su posición en el espacio, facilitando así su manejo y procesamiento.
 #define ZBINS 128
-static int *g_bin_idx = NULL; // N
-static int g_bin_cap = 0;
-static int *g_counts = NULL; // ZBINS
-static int *g_starts = NULL; // ZBINS
-static int *g_write = NULL;  // ZBINS
+static uint8_t *g_bin_idx = NULL; // N (ZBINS <= 256)
+static size_t g_bin_cap = 0;
+static size_t *g_counts = NULL; // ZBINS
+static size_t *g_starts = NULL; // ZBINS
+static size_t *g_write = NULL;  // ZBINS
+// --taskgraph: índices de cada chunk ordenados por bin (estable), así cada
+// tarea de scatter lee solo las esferas que caen en su tramo
+static uint32_t *g_bin_perm = NULL; // N
+
+// Crecimiento geométrico (x1.5) en size_t: sin desbordes para N grandes
+static size_t grow_capacity(size_t cap, size_t need)
+{
+    size_t newcap = (cap == 0) ? 4096 : cap;
+    while (newcap < need)
+        newcap += newcap / 2;
+    return newcap;
+}
+
+// Malla siguiente de un cambio de grilla en curso (cloth_resize): se arma por
+// tramos mientras se sigue simulando con g_X/g_Y y al terminar se intercambian.
+static float *g_Xn = NULL, *g_Yn = NULL;
+static size_t g_xyn_cap = 0;
 
 // Reserva amortizada para XY; evita realocar cada frame al crecer N
-static int ensure_capacity_xy(int N)
+static int ensure_xy(float **X, float **Y, size_t *cap, size_t N)
 {
-    if (N <= g_xy_cap)
+    if (N <= *cap)
         return 1;
-    int newcap = (g_xy_cap == 0) ? 4096 : g_xy_cap;
-    while (newcap < N)
-        newcap = (int)(newcap * 1.5f);
-    float *nx = (float *)realloc(g_X, (size_t)newcap * sizeof(float));
-    float *ny = (float *)realloc(g_Y, (size_t)newcap * sizeof(float));
-    if (!nx || !ny)
+    size_t newcap = grow_capacity(*cap, N);
+    float *nx = (float *)realloc(*X, newcap * sizeof(float));
+    if (!nx)
+        return 0;
+    *X = nx;
+    float *ny = (float *)realloc(*Y, newcap * sizeof(float));
+    if (!ny)
         return 0;
-    g_X = nx;
-    g_Y = ny;
-    g_xy_cap = newcap;
+    *Y = ny;
+    *cap = newcap;
     return 1;
 }
 
+static int ensure_capacity_xy(size_t N)
+{
+    return ensure_xy(&g_X, &g_Y, &g_xy_cap, N);
+}
+
 // Reserva para estructuras del bucket sort; ZBINS es fijo.
-static int ensure_capacity_bins(int N)
+static int ensure_capacity_bins(size_t N)
 {
     if (N > g_bin_cap)
     {
-        int newcap = (g_bin_cap == 0) ? 4096 : g_bin_cap;
-        while (newcap < N)
-            newcap = (int)(newcap * 1.5f);
-        int *nb = (int *)realloc(g_bin_idx, (size_t)newcap * sizeof(int));
+        size_t newcap = grow_capacity(g_bin_cap, N);
+        uint8_t *nb = (uint8_t *)realloc(g_bin_idx, newcap * sizeof(uint8_t));
         if (!nb)
             return 0;
         g_bin_idx = nb;
+        uint32_t *np = (uint32_t *)realloc(g_bin_perm, newcap * sizeof(uint32_t));
+        if (!np)
+            return 0;
+        g_bin_perm = np;
         g_bin_cap = newcap;
     }
     if (!g_counts)
-        g_counts = (int *)calloc(ZBINS, sizeof(int));
+        g_counts = (size_t *)calloc(ZBINS, sizeof(size_t));
     if (!g_starts)
-        g_starts = (int *)calloc(ZBINS, sizeof(int));
+        g_starts = (size_t *)calloc(ZBINS, sizeof(size_t));
     if (!g_write)
-        g_write = (int *)calloc(ZBINS, sizeof(int));
+        g_write = (size_t *)calloc(ZBINS, sizeof(size_t));
     return (g_counts && g_starts && g_write);
 }
 
 // order_idx vive en el estado porque lo consumen ambos backends de render.
-static int ensure_capacity_order(ClothState *S, int N)
+static int ensure_capacity_order(ClothState *S, size_t N)
 {
     if (N <= S->order_cap)
         return 1;
-    int newcap = (S->order_cap == 0) ? 4096 : S->order_cap;
-    while (newcap < N)
-        newcap = (int)(newcap * 1.5f);
-    int *no = (int *)realloc(S->order_idx, (size_t)newcap * sizeof(int));
+    size_t newcap = grow_capacity(S->order_cap, N);
+    int *no = (int *)realloc(S->order_idx, newcap * sizeof(int));
     if (!no)
         return 0;
     S->order_idx = no;
@@ -228,6 +150,87 @@ static int ensure_capacity_order(ClothState *S, int N)
     return 1;
 }
 
+// Salida del scatter con --sorted-draw: draw reordenado por profundidad
+static int ensure_capacity_sorted(ClothState *S, size_t N)
+{
+    if (!S->P.sortedDraw || N <= S->sorted_cap)
+        return 1;
+    size_t newcap = grow_capacity(S->sorted_cap, N);
+    DrawItem *ns = (DrawItem *)realloc(S->sorted, newcap * sizeof(DrawItem));
+    if (!ns)
+        return 0;
+    S->sorted = ns;
+    S->sorted_cap = newcap;
+    return 1;
+}
+
+// draw/depth: se reescriben enteros en cada update, pero con realloc un fallo
+// deja intactos los buffers actuales
+static int ensure_capacity_draw(ClothState *S, size_t N)
+{
+    if (N <= S->draw_cap)
+        return 1;
+    size_t newcap = grow_capacity(S->draw_cap, N);
+    DrawItem *nd = (DrawItem *)realloc(S->draw, newcap * sizeof(DrawItem));
+    if (!nd)
+        return 0;
+    S->draw = nd;
+    uint16_t *nz = (uint16_t *)realloc(S->depth, newcap * sizeof(uint16_t));
+    if (!nz)
+        return 0;
+    S->depth = nz;
+    S->draw_cap = newcap;
+    return 1;
+}
+
+// Escribe una vez cada página de [used, cap) en paralelo: el fallo de página
+// (y con OpenMP la ubicación NUMA por primer toque) se paga al reservar y no
+// en el frame que empieza a usar esa memoria.
+static void touch_tail(void *p, size_t used, size_t cap)
+{
+    if (!p || used >= cap)
+        return;
+    char *b = (char *)p;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (size_t off = used; off < cap; off += 4096)
+        b[off] = 0;
+}
+
+// Filas que simula este estado: la malla completa o la franja [bandY0, bandY1)
+static int band_rows(const ClothParams *P, int *row0)
+{
+    if (P->bandY1 > P->bandY0 && P->bandY0 >= 0 && P->bandY1 <= P->GY)
+    {
+        *row0 = P->bandY0;
+        return P->bandY1 - P->bandY0;
+    }
+    *row0 = 0;
+    return P->GY;
+}
+
+// Coordenadas base de la malla; v se calcula con la fila global para que
+// una franja coincida exactamente con su tramo de la malla completa. X/Y
+// apuntan a la primera fila del tramo [row0, row0 + rows).
+static void build_mesh(float *X, float *Y, int GX, int GY, int row0, int rows, float spanX, float spanY)
+{
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if ((size_t)rows * (size_t)GX > 65536)
+#endif
+    for (int j = 0; j < rows; ++j)
+    {
+        for (int i = 0; i < GX; ++i)
+        {
+            size_t idx = (size_t)j * (size_t)GX + (size_t)i;
+            float u = (i / (float)(GX - 1)) * 2.0f - 1.0f;
+            float v = ((row0 + j) / (float)(GY - 1)) * 2.0f - 1.0f;
+            X[idx] = u * (spanX * 0.5f);
+            Y[idx] = v * (spanY * 0.5f);
+        }
+    }
+}
+
 // Deriva una malla razonable a partir de N y el aspect ratio de la ventana.
 static void derive_grid_from_N(int N, int W, int H, int *GX, int *GY)
 {
@@ -248,11 +251,27 @@ static void derive_grid_from_N(int N, int W, int H, int *GX, int *GY)
     *GY = gY;
 }
 
+// Radio decodificado por código (ver sim.h)
+float draw_radius_lut[256];
+
+void draw_codec_init(void)
+{
+    for (int c = 0; c < 256; ++c)
+        draw_radius_lut[c] = exp2f((float)c / DRAW_R_STEPS - 2.0f);
+}
+
 // Inicializa estado, buffers y sprite. Precalcula la malla XY.
-int cloth_init(SDL_Renderer *R, ClothState *S, const ClothParams *P_in, int W, int H)
+static int sprite_radius(const ClothState *S)
+{
+    const int r = (int)ceilf(S->P.baseRadius);
+    return r < 2 ? 2 : r;
+}
+
+int cloth_init_buffers(ClothState *S, const ClothParams *P_in, int W, int H)
 {
-    if (!R || !S || !P_in || W <= 0 || H <= 0)
+    if (!S || !P_in || W <= 0 || H <= 0)
         return -1;
+    draw_codec_init();
 
     memset(S, 0, sizeof(*S));
     S->W_last = W;
@@ -270,8 +289,12 @@ int cloth_init(SDL_Renderer *R, ClothState *S, const ClothParams *P_in, int W, i
         if (S->P.GY <= 0)
             S->P.GY = gy;
     }
-    S->N = S->P.GX * S->P.GY;
-    if (S->N <= 0)
+    // Tamaños en 64 bits; los índices por esfera (order_idx, bins) son int32,
+    // suficiente hasta 2^31 esferas.
+    int row0;
+    const int rows = band_rows(&S->P, &row0);
+    S->N = (size_t)S->P.GX * (size_t)rows;
+    if (S->N == 0 || S->N > (size_t)INT_MAX)
         return -2;
 
     // Radio base automático si hace falta
@@ -284,50 +307,68 @@ int cloth_init(SDL_Renderer *R, ClothState *S, const ClothParams *P_in, int W, i
             S->P.baseRadius = 1.0f;
     }
 
-    S->draw = (DrawItem *)malloc(sizeof(DrawItem) * (size_t)S->N);
-    S->depth = (float *)malloc(sizeof(float) * (size_t)S->N);
+    S->draw = (DrawItem *)malloc(sizeof(DrawItem) * S->N);
+    S->depth = (uint16_t *)malloc(sizeof(uint16_t) * S->N);
     if (!S->draw || !S->depth)
         return -3;
+    S->draw_cap = S->N;
 
-    int spriteR = (int)ceilf(S->P.baseRadius);
-    if (spriteR < 2)
-        spriteR = 2;
-    S->sprite = make_circle_sprite(R, spriteR);
-    S->spriteRadius = spriteR;
-    if (!S->sprite)
-        return -4;
+    // Píxeles del sprite: la textura la crea cloth_init_finish en el hilo de SDL
+    const int r = sprite_radius(S);
+    free(g_sprite_px);
+    g_sprite_px = (Uint32 *)malloc((size_t)(2 * r) * (size_t)(2 * r) * sizeof(Uint32));
+    g_sprite_px_radius = g_sprite_px ? r : 0;
+    if (g_sprite_px)
+        cloth_kernels()->sprite(g_sprite_px, r);
 
     // Precompute XY inicial
+    const size_t bin0 = g_bin_cap;
     if (!ensure_capacity_xy(S->N))
         return -5;
     g_last_GX = S->P.GX;
-    g_last_GY = S->P.GY;
+    g_last_GY = rows;
     g_last_spanX = S->P.spanX;
     g_last_spanY = S->P.spanY;
     float spanX = (S->P.spanX > 0.f ? S->P.spanX : 2.0f);
     float spanY = (S->P.spanY > 0.f ? S->P.spanY : 2.0f);
-    for (int j = 0; j < S->P.GY; ++j)
-    {
-        for (int i = 0; i < S->P.GX; ++i)
-        {
-            int idx = j * S->P.GX + i;
-            float u = (i / (float)(S->P.GX - 1)) * 2.0f - 1.0f;
-            float v = (j / (float)(S->P.GY - 1)) * 2.0f - 1.0f;
-            g_X[idx] = u * (spanX * 0.5f);
-            g_Y[idx] = v * (spanY * 0.5f);
-        }
-    }
+    build_mesh(g_X, g_Y, S->P.GX, S->P.GY, row0, rows, spanX, spanY);
 
     if (!ensure_capacity_bins(S->N))
         return -6;
     if (!ensure_capacity_order(S, S->N))
         return -7;
+    if (!ensure_capacity_sorted(S, S->N))
+        return -8;
+    // Primer toque en paralelo: las páginas quedan repartidas como las
+    // usarán las regiones del update y el primer frame no paga los fallos.
+    // La malla ya se tocó al construirla.
+    touch_tail(S->draw, 0, S->draw_cap * sizeof(DrawItem));
+    touch_tail(S->depth, 0, S->draw_cap * sizeof(uint16_t));
+    touch_tail(g_bin_idx, bin0, g_bin_cap);
+    touch_tail(g_bin_perm, bin0 * sizeof(uint32_t), g_bin_cap * sizeof(uint32_t));
+    touch_tail(S->order_idx, 0, S->order_cap * sizeof(int));
+    touch_tail(S->sorted, 0, S->sorted_cap * sizeof(DrawItem));
 
     S->tx = 0.f;
     S->ty = 0.f;
     return 0;
 }
 
+int cloth_init_finish(SDL_Renderer *R, ClothState *S)
+{
+    if (!R || !S || !S->draw)
+        return -1;
+    return cloth_sync_sprite(R, S) != 0 ? -4 : 0;
+}
+
+int cloth_init(SDL_Renderer *R, ClothState *S, const ClothParams *P_in, int W, int H)
+{
+    if (!R)
+        return -1;
+    const int rc = cloth_init_buffers(S, P_in, W, H);
+    return rc != 0 ? rc : cloth_init_finish(R, S);
+}
+
 // Libera recursos del estado. Los buffers globales se dejan vivos para reuso.
 void cloth_destroy(ClothState *S)
 {
@@ -339,18 +380,195 @@ void cloth_destroy(ClothState *S)
     S->draw = NULL;
     free(S->depth);
     S->depth = NULL;
+    S->draw_cap = 0;
     free(S->order_idx);
     S->order_idx = NULL;
     S->order_cap = 0;
+    free(S->sorted);
+    S->sorted = NULL;
+    S->sorted_cap = 0;
 }
 
-// Actualiza posiciones proyectadas, colores, bounding box y orden de dibujo.
-void cloth_update(SDL_Renderer *R, ClothState *S, int W, int H, float t)
+int cloth_sync_sprite(SDL_Renderer *R, ClothState *S)
 {
-    (void)R; // no se usa aquí
-    if (!S || W <= 0 || H <= 0)
+    const int r = sprite_radius(S);
+    if (S->sprite && r == S->spriteRadius)
+        return 0;
+    // Si falla se conserva el sprite anterior (solo queda mal escalado)
+    SDL_Texture *tex = make_circle_sprite(R, r);
+    if (!tex)
+        return -1;
+    if (S->sprite)
+        SDL_DestroyTexture(S->sprite);
+    S->sprite = tex;
+    S->spriteRadius = r;
+    return 0;
+}
+
+int cloth_reserve(ClothState *S, size_t maxN)
+{
+    if (!S || maxN > (size_t)INT_MAX)
+        return -1;
+    const size_t xy0 = g_xy_cap, xyn0 = g_xyn_cap, draw0 = S->draw_cap, bin0 = g_bin_cap;
+    const size_t ord0 = S->order_cap, sort0 = S->sorted_cap;
+    if (!ensure_capacity_xy(maxN) || !ensure_xy(&g_Xn, &g_Yn, &g_xyn_cap, maxN) ||
+        !ensure_capacity_draw(S, maxN) || !ensure_capacity_bins(maxN) || !ensure_capacity_order(S, maxN) ||
+        !ensure_capacity_sorted(S, maxN))
+        return -1;
+    touch_tail(g_X, xy0 * sizeof(float), g_xy_cap * sizeof(float));
+    touch_tail(g_Y, xy0 * sizeof(float), g_xy_cap * sizeof(float));
+    touch_tail(g_Xn, xyn0 * sizeof(float), g_xyn_cap * sizeof(float));
+    touch_tail(g_Yn, xyn0 * sizeof(float), g_xyn_cap * sizeof(float));
+    touch_tail(S->draw, draw0 * sizeof(DrawItem), S->draw_cap * sizeof(DrawItem));
+    touch_tail(S->depth, draw0 * sizeof(uint16_t), S->draw_cap * sizeof(uint16_t));
+    touch_tail(g_bin_idx, bin0, g_bin_cap);
+    touch_tail(g_bin_perm, bin0 * sizeof(uint32_t), g_bin_cap * sizeof(uint32_t));
+    touch_tail(S->order_idx, ord0 * sizeof(int), S->order_cap * sizeof(int));
+    touch_tail(S->sorted, sort0 * sizeof(DrawItem), S->sorted_cap * sizeof(DrawItem));
+    return 0;
+}
+
+// Etapas de reserva de un cambio de grilla (ver resize_reserve)
+#define RESIZE_STAGES 5
+
+int cloth_resize(ClothState *S, int GX, int GY, float radius)
+{
+    if (!S || GX < 2 || GY < 2 || (size_t)GX * (size_t)GY > (size_t)INT_MAX)
+        return -1;
+    // Una franja (--dist) es parte de la malla de otro: no se redimensiona sola
+    if (S->P.bandY1 > S->P.bandY0)
+        return -1;
+    if (GX == S->P.GX && GY == S->P.GY)
+    {
+        // Misma grilla: se cancela un cambio pendiente y solo cambia el radio
+        S->next_GX = S->next_GY = 0;
+        if (radius > 0.0f)
+            S->P.baseRadius = radius;
+        return 0;
+    }
+    S->next_GX = GX;
+    S->next_GY = GY;
+    S->next_row = -RESIZE_STAGES;
+    S->next_radius = radius;
+    return 1;
+}
+
+int cloth_resize_pending(const ClothState *S)
+{
+    return S && S->next_GX > 0;
+}
+
+// Puntos de la malla nueva que se construyen por frame durante un cambio de
+// grilla: el costo extra queda repartido y acotado en vez de caer en un frame
+#define RESIZE_STEP_POINTS ((size_t)1 << 20)
+
+// Etapa s de las reservas para N esferas de un cambio de grilla. Devuelve 1
+// si reservó (y tocó) memoria, 0 si ya alcanzaba y -1 sin memoria.
+static int resize_reserve(ClothState *S, int stage, size_t N)
+{
+    size_t c0;
+    switch (stage)
+    {
+    case 0:
+        c0 = g_xyn_cap;
+        return ensure_xy(&g_Xn, &g_Yn, &g_xyn_cap, N) ? (g_xyn_cap != c0) : -1;
+    case 1:
+        c0 = S->draw_cap;
+        if (!ensure_capacity_draw(S, N))
+            return -1;
+        touch_tail(S->draw, c0 * sizeof(DrawItem), S->draw_cap * sizeof(DrawItem));
+        touch_tail(S->depth, c0 * sizeof(uint16_t), S->draw_cap * sizeof(uint16_t));
+        return S->draw_cap != c0;
+    case 2:
+        c0 = g_bin_cap;
+        if (!ensure_capacity_bins(N))
+            return -1;
+        touch_tail(g_bin_idx, c0, g_bin_cap);
+        touch_tail(g_bin_perm, c0 * sizeof(uint32_t), g_bin_cap * sizeof(uint32_t));
+        return g_bin_cap != c0;
+    case 3:
+        c0 = S->order_cap;
+        if (!ensure_capacity_order(S, N))
+            return -1;
+        touch_tail(S->order_idx, c0 * sizeof(int), S->order_cap * sizeof(int));
+        return S->order_cap != c0;
+    default:
+        c0 = S->sorted_cap;
+        if (!ensure_capacity_sorted(S, N))
+            return -1;
+        touch_tail(S->sorted, c0 * sizeof(DrawItem), S->sorted_cap * sizeof(DrawItem));
+        return S->sorted_cap != c0;
+    }
+}
+
+// Avanza el cambio de grilla pendiente. Primero las reservas (next_row < 0),
+// a lo sumo una que crezca por frame; después la malla por tramos, y en el
+// frame en que está completa se adopta (N, radio) antes del update sin
+// reservar nada.
+static void resize_step(SDL_Renderer *R, ClothState *S)
+{
+    const int GX = S->next_GX, GY = S->next_GY;
+    const size_t N = (size_t)GX * (size_t)GY;
+    while (S->next_row < 0)
+    {
+        const int r = resize_reserve(S, RESIZE_STAGES + S->next_row, N);
+        if (r < 0)
+        {
+            fprintf(stderr, "cloth: sin memoria para la malla %dx%d; se mantiene la actual\n", GX, GY);
+            S->next_GX = S->next_GY = 0;
+            return;
+        }
+        S->next_row++;
+        if (r > 0)
+            return;
+    }
+    const float spanX = (S->P.spanX > 0.f ? S->P.spanX : 2.0f);
+    const float spanY = (S->P.spanY > 0.f ? S->P.spanY : 2.0f);
+    size_t step = RESIZE_STEP_POINTS / (size_t)GX;
+    if (step < 1)
+        step = 1;
+    const int rows = (step < (size_t)(GY - S->next_row)) ? (int)step : GY - S->next_row;
+    const size_t off = (size_t)S->next_row * (size_t)GX;
+    TraceSpan sp = trace_begin("resize-mesh");
+    build_mesh(g_Xn + off, g_Yn + off, GX, GY, S->next_row, rows, spanX, spanY);
+    trace_end(sp);
+    S->next_row += rows;
+    if (S->next_row < GY)
         return;
 
+    float *tx = g_X, *ty = g_Y;
+    const size_t tcap = g_xy_cap;
+    g_X = g_Xn;
+    g_Y = g_Yn;
+    g_xy_cap = g_xyn_cap;
+    g_Xn = tx;
+    g_Yn = ty;
+    g_xyn_cap = tcap;
+
+    if (S->next_radius > 0.0f)
+        S->P.baseRadius = S->next_radius;
+    else
+    {
+        // Radio a escala de la celda: la tela ocupa lo mismo con más o menos esferas
+        const float k = fminf((float)S->P.GX / (float)GX, (float)S->P.GY / (float)GY);
+        S->P.baseRadius = fmaxf(1.0f, S->P.baseRadius * k);
+    }
+    S->P.GX = GX;
+    S->P.GY = GY;
+    S->N = N;
+    g_last_GX = GX;
+    g_last_GY = GY;
+    g_last_spanX = spanX;
+    g_last_spanY = spanY;
+    S->next_GX = S->next_GY = 0;
+    if (R)
+        cloth_sync_sprite(R, S);
+}
+
+// Parte común de cloth_update y cloth_update_graph: reacciona a cambios de
+// ventana/malla, reserva buffers y arma los argumentos del kernel de update.
+static int prepare_update(SDL_Renderer *R, ClothState *S, int W, int H, float t, ClothUpdateArgs *ka)
+{
     // Reacciona a cambios de tamaño: recalcula radio base y recrea sprite si hace falta.
     if (W != S->W_last || H != S->H_last)
     {
@@ -363,21 +581,20 @@ void cloth_update(SDL_Renderer *R, ClothState *S, int W, int H, float t)
             if (newBase < 1.0f)
                 newBase = 1.0f;
         }
-        int newR = (int)ceilf(newBase);
-        if (newR != S->spriteRadius)
-        {
-            if (S->sprite)
-                SDL_DestroyTexture(S->sprite);
-            S->sprite = make_circle_sprite(R, newR);
-            S->spriteRadius = newR;
-        }
         S->P.baseRadius = newBase;
         S->W_last = W;
         S->H_last = H;
     }
+    if (S->next_GX > 0)
+        resize_step(R, S);
+    // Sin renderer (update fuera del hilo de SDL) el sprite se sincroniza aparte
+    if (R)
+        cloth_sync_sprite(R, S);
 
-    const int GX = S->P.GX, GY = S->P.GY;
-    const int N = GX * GY;
+    // GY son las filas propias (toda la malla o la franja)
+    int row0;
+    const int GX = S->P.GX, GY = band_rows(&S->P, &row0);
+    const size_t N = (size_t)GX * (size_t)GY;
 
     // Controlan que tan ancha y alta es la malla
     float spanX = (S->P.spanX > 0.f ? S->P.spanX : 2.0f);
@@ -387,27 +604,21 @@ void cloth_update(SDL_Renderer *R, ClothState *S, int W, int H, float t)
     if (GX != g_last_GX || GY != g_last_GY || spanX != g_last_spanX || spanY != g_last_spanY)
     {
         if (!ensure_capacity_xy(N))
-            return;
+            return 0;
         g_last_GX = GX;
         g_last_GY = GY;
         g_last_spanX = spanX;
         g_last_spanY = spanY;
-        for (int j = 0; j < GY; ++j)
-        {
-            for (int i = 0; i < GX; ++i)
-            {
-                int idx = j * GX + i;
-                float u = (i / (float)(GX - 1)) * 2.0f - 1.0f;
-                float v = (j / (float)(GY - 1)) * 2.0f - 1.0f;
-                g_X[idx] = u * (spanX * 0.5f);
-                g_Y[idx] = v * (spanY * 0.5f);
-            }
-        }
+        build_mesh(g_X, g_Y, GX, S->P.GY, row0, GY, spanX, spanY);
     }
     if (!ensure_capacity_bins(N))
-        return;
+        return 0;
     if (!ensure_capacity_order(S, N))
-        return;
+        return 0;
+    if (!ensure_capacity_sorted(S, N))
+        return 0;
+    S->bin_start = g_starts;
+    S->nbins = ZBINS;
 
     const float DEG2RAD = (float)M_PI / 180.0f;
     const float tiltX = S->P.tiltX_deg * DEG2RAD;
@@ -425,78 +636,101 @@ void cloth_update(SDL_Renderer *R, ClothState *S, int W, int H, float t)
     float cx = 0.45f * spanX * sinf(0.9f * spd * t);
     float cy = 0.45f * spanY * cosf(1.2f * spd * t + 0.7f);
 
-    // Onda base + gaussiana radial; inv2sig2 evita dividir dentro del bucle.
-    const float kx = 2.2f, ky = 1.7f;
-    const float inv2sig2 = 1.0f / (2.0f * sig * sig);
+    // inv2sig2 evita dividir dentro del bucle.
+    ka->GX = GX;
+    ka->GY = GY;
+    ka->W = W;
+    ka->H = H;
+    ka->t = t;
+    ka->X = g_X;
+    ka->Y = g_Y;
+    ka->tiltX = tiltX;
+    ka->tiltY = tiltY;
+    ka->zCam = zCam;
+    ka->fov = fov;
+    ka->amp = amp;
+    ka->inv2sig2 = 1.0f / (2.0f * sig * sig);
+    ka->omg = omg;
+    ka->cs = cs;
+    ka->cx = cx;
+    ka->cy = cy;
+    ka->baseRadius = S->P.baseRadius;
+    {
+        // Cota analítica de z: la malla rotada cabe en una esfera centrada en
+        // la imagen de (0,0,2); |Z| <= 0.22 + amp. Así la clave de 16 bits
+        // sale en un solo pase, sin conocer antes el min/max del frame.
+        Vec3 c = {0.f, 0.f, 2.0f};
+        c = rotY(rotX(c, tiltX), tiltY);
+        const float hz = 0.22f + fabsf(amp);
+        const float Rb = sqrtf(0.25f * (spanX * spanX + spanY * spanY) + hz * hz);
+        ka->zlo = c.z - Rb;
+        ka->zscale = 65535.0f / (2.0f * Rb);
+    }
+    ka->draw = S->draw;
+    ka->depth = S->depth;
+    ka->tx = S->tx;
+    ka->ty = S->ty;
+    ka->j0 = 0;
+    ka->j1 = GY;
+    ka->par = 1;
+    return 1;
+}
 
-    // Update por punto y min/max de profundidad en reducciones.
-    float zmin = 1e30f, zmax = -1e30f;
+void cloth_center_step(float *tx, float *ty, float tx_target, float ty_target)
+{
+    const float alpha = 0.2f;
+    *tx += alpha * (tx_target - *tx);
+    *ty += alpha * (ty_target - *ty);
+}
 
-#ifdef _OPENMP
-// Para calcular la profundidad de cada punto y min/max de profundidad
-#pragma omp parallel for collapse(2) schedule(static) reduction(min : zmin) reduction(max : zmax)
-#endif
-    for (int j = 0; j < GY; ++j)
+// Paneo suavizado hacia el centro del bbox (o solo el paneo fijo si no hay autoCenter)
+static void apply_center(ClothState *S, int W, int H, float minx, float maxx, float miny, float maxy)
+{
+    float tx_target = S->P.panX_px, ty_target = S->P.panY_px;
+    if (S->P.autoCenter)
     {
-        for (int i = 0; i < GX; ++i)
-        {
-            int idx = j * GX + i;
-
-            float X = g_X[idx];
-            float Y = g_Y[idx];
-
-            float base = 0.22f * sinf(kx * X + 0.7f * t) * cosf(ky * Y + 0.9f * t);
-            float dx = X - cx, dy = Y - cy;
-            float r2 = dx * dx + dy * dy;
-            float g = expf(-(r2)*inv2sig2);
-            float Z = base + amp * g * sinf(omg * t + r2 * 0.6f);
-
-            Vec3 P = {X, Y, 2.0f + Z};
-            P = rotX(P, tiltX);
-            P = rotY(P, tiltY);
-
-            S->depth[idx] = P.z;
-            if (P.z < zmin)
-                zmin = P.z;
-            if (P.z > zmax)
-                zmax = P.z;
-
-            Vec2 Scr = project_point(P, W, H, fov, zCam);
-            float denom = (P.z - zCam);
-            if (UNLIKELY(fabsf(denom) < 1e-4f))
-                denom = (denom >= 0.f ? 1e-4f : -1e-4f);
-            float scale = fov / denom;
-            float radius = S->P.baseRadius * clampf(scale * 0.9f, 0.5f, 2.1f);
-
-            float u = (i / (float)(GX - 1)) * 2.0f - 1.0f;
-            float hue = 0.6f + 0.25f * Z + cs * t + 0.08f * u;
-            unsigned char R8, G8, B8;
-            hsv_to_rgb(hue, 0.8f, 0.95f, &R8, &G8, &B8);
-
-            DrawItem di;
-            di.x = Scr.x;
-            di.y = Scr.y;
-            di.r = radius;
-            di.r8 = R8;
-            di.g8 = G8;
-            di.b8 = B8;
-            di.a8 = 220;
-            S->draw[idx] = di;
-        }
+        float cx2 = 0.5f * (minx + maxx);
+        float cy2 = 0.5f * (miny + maxy);
+        tx_target = (W * 0.5f - cx2) + S->P.panX_px;
+        ty_target = (H * 0.5f - cy2) + S->P.panY_px;
     }
+    S->tx_target = tx_target;
+    S->ty_target = ty_target;
+    cloth_center_step(&S->tx, &S->ty, tx_target, ty_target);
+}
 
-    // Centrado/paneo (reducción en bbox)
-    float tx_target = S->P.panX_px, ty_target = S->P.panY_px;
+// Actualiza posiciones proyectadas, colores, bounding box y orden de dibujo.
+void cloth_update(SDL_Renderer *R, ClothState *S, int W, int H, float t)
+{
+    if (!S || W <= 0 || H <= 0)
+        return;
+
+    ClothUpdateArgs ka;
+    if (!prepare_update(R, S, W, H, t, &ka))
+        return;
+    const size_t N = (size_t)ka.GX * (size_t)ka.GY;
+
+    // Update por punto y min/max de profundidad en reducciones.
+    perf_stage_begin(PERF_ST_UPDATE);
+    cloth_kernels()->update_points(&ka);
+    perf_stage_end(PERF_ST_UPDATE, N);
+    const unsigned kmin = ka.kmin, kmax = ka.kmax;
+    S->visible = ka.visible;
+
+    // Centrado/paneo (reducción en bbox, sobre las coordenadas cuantizadas)
+    float minx = 1e30f, maxx = -1e30f, miny = 1e30f, maxy = -1e30f;
     if (S->P.autoCenter)
     {
-        float minx = 1e30f, maxx = -1e30f, miny = 1e30f, maxy = -1e30f;
+        unsigned qminx = 65535u, qmaxx = 0u, qminy = 65535u, qmaxy = 0u;
+        perf_stage_begin(PERF_ST_BBOX);
 #ifdef _OPENMP
 // Para el bounding box
 #pragma omp parallel
         {
-            float lminx = 1e30f, lmaxx = -1e30f, lminy = 1e30f, lmaxy = -1e30f;
+            TraceSpan sp = trace_begin("bbox");
+            unsigned lminx = 65535u, lmaxx = 0u, lminy = 65535u, lmaxy = 0u;
 #pragma omp for nowait
-            for (int k = 0; k < N; ++k)
+            for (size_t k = 0; k < N; ++k)
             {
                 const DrawItem *d = &S->draw[k];
                 if (d->x < lminx)
@@ -508,93 +742,391 @@ void cloth_update(SDL_Renderer *R, ClothState *S, int W, int H, float t)
                 if (d->y > lmaxy)
                     lmaxy = d->y;
             }
+            trace_end(sp);
+            // La espera por el critical queda visible en la traza
+            sp = trace_begin("bbox-merge");
 #pragma omp critical
             {
-                if (lminx < minx)
-                    minx = lminx;
-                if (lmaxx > maxx)
-                    maxx = lmaxx;
-                if (lminy < miny)
-                    miny = lminy;
-                if (lmaxy > maxy)
-                    maxy = lmaxy;
+                if (lminx < qminx)
+                    qminx = lminx;
+                if (lmaxx > qmaxx)
+                    qmaxx = lmaxx;
+                if (lminy < qminy)
+                    qminy = lminy;
+                if (lmaxy > qmaxy)
+                    qmaxy = lmaxy;
             }
+            trace_end(sp);
         }
 #else
-        for (int k = 0; k < N; ++k)
+        for (size_t k = 0; k < N; ++k)
         {
             const DrawItem *d = &S->draw[k];
-            if (d->x < minx)
-                minx = d->x;
-            if (d->x > maxx)
-                maxx = d->x;
-            if (d->y < miny)
-                miny = d->y;
-            if (d->y > maxy)
-                maxy = d->y;
+            if (d->x < qminx)
+                qminx = d->x;
+            if (d->x > qmaxx)
+                qmaxx = d->x;
+            if (d->y < qminy)
+                qminy = d->y;
+            if (d->y > qmaxy)
+                qmaxy = d->y;
         }
 #endif
-        float cx2 = 0.5f * (minx + maxx);
-        float cy2 = 0.5f * (miny + maxy);
-        tx_target = (W * 0.5f - cx2) + S->P.panX_px;
-        ty_target = (H * 0.5f - cy2) + S->P.panY_px;
+        perf_stage_end(PERF_ST_BBOX, N);
+        minx = draw_dec_xy((uint16_t)qminx);
+        maxx = draw_dec_xy((uint16_t)qmaxx);
+        miny = draw_dec_xy((uint16_t)qminy);
+        maxy = draw_dec_xy((uint16_t)qmaxy);
     }
-    const float alpha = 0.2f;
-    S->tx += alpha * (tx_target - S->tx);
-    S->ty += alpha * (ty_target - S->ty);
+    apply_center(S, W, H, minx, maxx, miny, maxy);
 
     // BUCKET SORT O(N)
-    float range = (zmax - zmin);
-    if (range < 1e-6f)
-        range = 1e-6f;
-    float invRange = (float)(ZBINS - 1) / range;
+    const unsigned range = (kmax > kmin ? kmax - kmin : 1u);
+    float invRange = (float)(ZBINS - 1) / (float)range;
 
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static)
-#endif
-    for (int k = 0; k < N; ++k)
-    {
-        int b = (int)((S->depth[k] - zmin) * invRange + 0.5f);
-        if (b < 0)
-            b = 0;
-        else if (b >= ZBINS)
-            b = ZBINS - 1;
-        g_bin_idx[k] = b;
-    }
+    perf_stage_begin(PERF_ST_BIN);
+    cloth_kernels()->bin_index(S->depth, g_bin_idx, N, (float)kmin, invRange, ZBINS, 1);
 
-    memset(g_counts, 0, sizeof(int) * ZBINS);
+    memset(g_counts, 0, sizeof(size_t) * ZBINS);
 #ifdef _OPENMP
 // Para el conteo de bins
-#pragma omp parallel for schedule(static)
+#pragma omp parallel
 #endif
-    for (int k = 0; k < N; ++k)
     {
+        TraceSpan sp = trace_begin("bin-count");
+#ifdef _OPENMP
+#pragma omp for schedule(static) nowait
+#endif
+        for (size_t k = 0; k < N; ++k)
+        {
 #ifdef _OPENMP
 #pragma omp atomic
 #endif
-        g_counts[g_bin_idx[k]]++;
+            g_counts[g_bin_idx[k]]++;
+        }
+        trace_end(sp);
     }
+    perf_stage_end(PERF_ST_BIN, N);
 
-    int sum = 0;
+    perf_stage_begin(PERF_ST_SCATTER);
+    TraceSpan sp_prefix = trace_begin("prefix");
+    size_t sum = 0;
     for (int b = 0; b < ZBINS; ++b)
     {
         g_starts[b] = sum;
         g_write[b] = sum;
         sum += g_counts[b];
     }
+    trace_end(sp_prefix);
 
+    // Con sorted, el scatter mueve la esfera completa a su posición final: la
+    // lectura de draw es lineal y el render ya no hace un gather aleatorio.
+    const DrawItem *draw = S->draw;
+    DrawItem *sorted = S->sorted;
+    int *order = (sorted && !S->P.keepOrder) ? NULL : S->order_idx;
 #ifdef _OPENMP
 // Para escribir posiciones únicas en order_idx
-#pragma omp parallel for schedule(static)
+#pragma omp parallel
 #endif
-    for (int k = 0; k < N; ++k)
     {
-        int b = g_bin_idx[k];
-        int pos;
+        TraceSpan sp = trace_begin("scatter");
+#ifdef _OPENMP
+#pragma omp for schedule(static) nowait
+#endif
+        for (size_t k = 0; k < N; ++k)
+        {
+            int b = g_bin_idx[k];
+            size_t pos;
 #ifdef _OPENMP
 #pragma omp atomic capture
 #endif
-        pos = g_write[b]++;
-        S->order_idx[pos] = k;
+            pos = g_write[b]++;
+            if (sorted)
+                sorted[pos] = draw[k];
+            if (order)
+                order[pos] = (int)k;
+        }
+        trace_end(sp);
+    }
+    perf_stage_end(PERF_ST_SCATTER, N);
+}
+
+#ifdef _OPENMP
+// ---- Versión como grafo de tareas ----
+// El frame se parte en chunks de filas; cada etapa por chunk depende solo de
+// lo que necesita, sin barreras globales entre regiones paralelas:
+//   UPD[k] -> BBOX[k] -> CENTER          (bbox de todos los chunks)
+//   UPD[*] -> ZRED -> BIN[k] -> PREFIX -> SCAT[k][r] -> RANGE[r]
+// BIN y SCAT usan conteos por chunk: el scatter no necesita atómicos y el
+// orden resultante es determinista (estable dentro de cada bin). El scatter
+// se parte además en tramos r de posiciones de salida: RANGE[r] (más CENTER)
+// es todo lo que necesita la geometría de ese tramo, así que el dibujo de los
+// primeros tramos se solapa con el scatter de los siguientes. BIN deja los
+// índices del chunk agrupados por bin para que SCAT[k][r] recorra solo los
+// bins de su tramo: cada esfera se lee una vez, no una por tramo.
+#define TG_MAX_CHUNKS 64
+
+static struct
+{
+    ClothState *S;
+    int W, H;
+    int nchunks;
+    ClothUpdateArgs part[TG_MAX_CHUNKS];
+    float bbox[TG_MAX_CHUNKS][4];
+    size_t cnt[TG_MAX_CHUNKS][ZBINS]; // conteos por chunk; PREFIX los vuelve offsets
+    size_t lbeg[TG_MAX_CHUNKS][ZBINS + 1]; // tramo de cada bin en g_bin_perm
+    float kmin, invRange; // clave mínima del frame y escala a bins
+    size_t span;          // posiciones de salida por tramo
+    int nranges;
+    int rbin[CLOTH_TG_RANGES][2]; // primer y último bin que caen en cada tramo
+} g_tg;
+
+static void chunk_range(int k, size_t *k0, size_t *k1)
+{
+    const ClothUpdateArgs *a = &g_tg.part[k];
+    *k0 = (size_t)a->j0 * (size_t)a->GX;
+    *k1 = (size_t)a->j1 * (size_t)a->GX;
+}
+
+static void task_update(void *ctx, long k, long b)
+{
+    (void)ctx;
+    (void)b;
+    cloth_kernels()->update_points(&g_tg.part[k]);
+}
+
+static void task_bbox(void *ctx, long k, long b)
+{
+    (void)ctx;
+    (void)b;
+    size_t k0, k1;
+    chunk_range((int)k, &k0, &k1);
+    const DrawItem *draw = g_tg.S->draw;
+    unsigned minx = 65535u, maxx = 0u, miny = 65535u, maxy = 0u;
+    for (size_t q = k0; q < k1; ++q)
+    {
+        const DrawItem *d = &draw[q];
+        if (d->x < minx)
+            minx = d->x;
+        if (d->x > maxx)
+            maxx = d->x;
+        if (d->y < miny)
+            miny = d->y;
+        if (d->y > maxy)
+            maxy = d->y;
     }
+    g_tg.bbox[k][0] = draw_dec_xy((uint16_t)minx);
+    g_tg.bbox[k][1] = draw_dec_xy((uint16_t)maxx);
+    g_tg.bbox[k][2] = draw_dec_xy((uint16_t)miny);
+    g_tg.bbox[k][3] = draw_dec_xy((uint16_t)maxy);
 }
+
+static void task_center(void *ctx, long a, long b)
+{
+    (void)ctx;
+    (void)a;
+    (void)b;
+    float minx = 1e30f, maxx = -1e30f, miny = 1e30f, maxy = -1e30f;
+    if (g_tg.S->P.autoCenter)
+    {
+        for (int k = 0; k < g_tg.nchunks; ++k)
+        {
+            minx = fminf(minx, g_tg.bbox[k][0]);
+            maxx = fmaxf(maxx, g_tg.bbox[k][1]);
+            miny = fminf(miny, g_tg.bbox[k][2]);
+            maxy = fmaxf(maxy, g_tg.bbox[k][3]);
+        }
+    }
+    apply_center(g_tg.S, g_tg.W, g_tg.H, minx, maxx, miny, maxy);
+}
+
+static void task_zreduce(void *ctx, long a, long b)
+{
+    (void)ctx;
+    (void)a;
+    (void)b;
+    unsigned kmin = 65535u, kmax = 0u;
+    size_t vis = 0;
+    for (int k = 0; k < g_tg.nchunks; ++k)
+    {
+        if (g_tg.part[k].kmin < kmin)
+            kmin = g_tg.part[k].kmin;
+        if (g_tg.part[k].kmax > kmax)
+            kmax = g_tg.part[k].kmax;
+        vis += g_tg.part[k].visible;
+    }
+    g_tg.S->visible = vis;
+    const unsigned range = (kmax > kmin ? kmax - kmin : 1u);
+    g_tg.kmin = (float)kmin;
+    g_tg.invRange = (float)(ZBINS - 1) / (float)range;
+}
+
+static void task_bin(void *ctx, long k, long b)
+{
+    (void)ctx;
+    (void)b;
+    size_t k0, k1;
+    chunk_range((int)k, &k0, &k1);
+    cloth_kernels()->bin_index(g_tg.S->depth + k0, g_bin_idx + k0, k1 - k0,
+                               g_tg.kmin, g_tg.invRange, ZBINS, 0);
+    size_t *cnt = g_tg.cnt[k];
+    memset(cnt, 0, sizeof(size_t) * ZBINS);
+    for (size_t q = k0; q < k1; ++q)
+        cnt[g_bin_idx[q]]++;
+    // Orden local por bin (estable) dentro del tramo [k0, k1) de g_bin_perm
+    size_t *lbeg = g_tg.lbeg[k];
+    size_t pos[ZBINS];
+    size_t sum = k0;
+    for (int bin = 0; bin < ZBINS; ++bin)
+    {
+        lbeg[bin] = pos[bin] = sum;
+        sum += cnt[bin];
+    }
+    lbeg[ZBINS] = sum;
+    for (size_t q = k0; q < k1; ++q)
+        g_bin_perm[pos[g_bin_idx[q]]++] = (uint32_t)q;
+}
+
+// Offsets de cada (bin, chunk): los chunks escriben tramos disjuntos de cada bin
+static void task_prefix(void *ctx, long a, long b)
+{
+    (void)ctx;
+    (void)a;
+    (void)b;
+    size_t sum = 0;
+    for (int bin = 0; bin < ZBINS; ++bin)
+    {
+        g_starts[bin] = sum;
+        g_counts[bin] = 0;
+        for (int k = 0; k < g_tg.nchunks; ++k)
+        {
+            size_t c = g_tg.cnt[k][bin];
+            g_tg.cnt[k][bin] = sum;
+            sum += c;
+            g_counts[bin] += c;
+        }
+    }
+    // Bins de cada tramo [r*span, (r+1)*span): los de los bordes se comparten
+    const size_t N = sum;
+    int bin = 0;
+    for (int r = 0; r < g_tg.nranges; ++r)
+    {
+        const size_t p0 = (size_t)r * g_tg.span;
+        size_t p1 = p0 + g_tg.span;
+        if (p1 > N)
+            p1 = N;
+        while (bin < ZBINS - 1 && g_starts[bin] + g_counts[bin] <= p0)
+            bin++;
+        g_tg.rbin[r][0] = bin;
+        int last = bin;
+        while (last < ZBINS - 1 && g_starts[last] + g_counts[last] < p1)
+            last++;
+        g_tg.rbin[r][1] = last;
+    }
+}
+
+// Scatter del chunk k restringido al tramo r de la salida: solo recorre los
+// bins [b0, b1] del tramo y, en los de los bordes, salta lo que cae fuera.
+static void task_scatter(void *ctx, long k, long r)
+{
+    (void)ctx;
+    const int b0 = g_tg.rbin[r][0], b1 = g_tg.rbin[r][1];
+    const size_t p0 = (size_t)r * g_tg.span, p1 = p0 + g_tg.span;
+    const size_t *lbeg = g_tg.lbeg[k];
+    const ClothState *S = g_tg.S;
+    DrawItem *sorted = S->sorted;
+    const DrawItem *draw = S->draw;
+    int *order = (!sorted || S->P.keepOrder) ? S->order_idx : NULL;
+    for (int bin = b0; bin <= b1; ++bin)
+    {
+        size_t p = g_tg.cnt[k][bin];
+        size_t i = lbeg[bin];
+        const size_t end = lbeg[bin + 1];
+        if (p < p0)
+        {
+            const size_t skip = (p0 - p < end - i) ? p0 - p : end - i;
+            i += skip;
+            p += skip;
+        }
+        for (; i < end && p < p1; ++i, ++p)
+        {
+            const uint32_t q = g_bin_perm[i];
+            if (sorted)
+                sorted[p] = draw[q];
+            if (order)
+                order[p] = (int)q;
+        }
+    }
+}
+
+static void task_nop(void *ctx, long a, long b)
+{
+    (void)ctx;
+    (void)a;
+    (void)b;
+}
+
+int cloth_update_graph(TaskGraph *G, SDL_Renderer *R, ClothState *S, int W, int H, float t,
+                       ClothGraphDeps *deps)
+{
+    deps->n = 0;
+    deps->span = 0;
+    if (!S || W <= 0 || H <= 0)
+        return -1;
+    ClothUpdateArgs ka;
+    if (!prepare_update(R, S, W, H, t, &ka))
+        return -1;
+
+    // ~4 chunks por hilo para que el robo de trabajo tenga margen
+    const int GY = ka.GY;
+    int nchunks = 4 * tg_num_threads(G);
+    if (nchunks > TG_MAX_CHUNKS)
+        nchunks = TG_MAX_CHUNKS;
+    if (nchunks > GY)
+        nchunks = GY;
+    const int rows_per = (GY + nchunks - 1) / nchunks;
+    nchunks = (GY + rows_per - 1) / rows_per;
+
+    g_tg.S = S;
+    g_tg.W = W;
+    g_tg.H = H;
+    g_tg.nchunks = nchunks;
+
+    const size_t N = S->N;
+    size_t span = (N + CLOTH_TG_RANGES - 1) / CLOTH_TG_RANGES;
+    if (span == 0)
+        span = 1;
+    g_tg.span = span;
+    g_tg.nranges = (int)((N + span - 1) / span);
+
+    int upd[TG_MAX_CHUNKS], bbox[TG_MAX_CHUNKS], bin[TG_MAX_CHUNKS];
+    for (int k = 0; k < nchunks; ++k)
+    {
+        ClothUpdateArgs *a = &g_tg.part[k];
+        *a = ka;
+        a->j0 = k * rows_per;
+        a->j1 = (a->j0 + rows_per < GY) ? a->j0 + rows_per : GY;
+        a->par = 0;
+        upd[k] = tg_add(G, "update", task_update, NULL, k, 0, 0, NULL, 0);
+    }
+    for (int k = 0; k < nchunks; ++k)
+        bbox[k] = S->P.autoCenter ? tg_add(G, "bbox", task_bbox, NULL, k, 0, 0, &upd[k], 1) : -1;
+    const int center = tg_add(G, "center", task_center, NULL, 0, 0, 0, bbox, nchunks);
+    const int zred = tg_add(G, "zreduce", task_zreduce, NULL, 0, 0, 0, upd, nchunks);
+    for (int k = 0; k < nchunks; ++k)
+        bin[k] = tg_add(G, "bin", task_bin, NULL, k, 0, 0, &zred, 1);
+    const int prefix = tg_add(G, "prefix", task_prefix, NULL, 0, 0, 0, bin, nchunks);
+    // Tramos en orden: el robo FIFO tiende a terminar primero el tramo 0
+    int scat[TG_MAX_CHUNKS + 1];
+    for (int r = 0; r < g_tg.nranges; ++r)
+    {
+        for (int k = 0; k < nchunks; ++k)
+            scat[k] = tg_add(G, "scatter", task_scatter, NULL, k, r, 0, &prefix, 1);
+        scat[nchunks] = center;
+        deps->dep[r] = tg_add(G, "range-join", task_nop, NULL, r, 0, 0, scat, nchunks + 1);
+    }
+    deps->n = g_tg.nranges;
+    deps->span = span;
+    return tg_add(G, "update-join", task_nop, NULL, 0, 0, 0, deps->dep, deps->n);
+}
+#endif
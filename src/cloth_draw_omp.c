@@ -1,125 +1,251 @@
 #include "cloth.h"
+#include "cloth_kernels.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <SDL2/SDL.h>
 
 #ifdef _OPENMP
 #include <omp.h>
+#include "taskgraph.h"
 #endif
 
-// Buffers de geometría (reusables entre frames)
-static SDL_Vertex *g_verts = NULL;
-static int g_verts_cap = 0;
-static int *g_index = NULL;
-static int g_index_cap = 0;
+// La geometría se envía en chunks de tamaño fijo: 16384 esferas = 65536
+// vértices, así los índices de cada chunk caben en 16 bits y el patrón de
+// índices es idéntico para todos (se construye una sola vez). La memoria de
+// geometría queda acotada sin importar N.
+#define GEO_CHUNK 16384
+// Cada cuántos chunks se vacía la cola interna de SDL (también crece con N)
+#define GEO_FLUSH_EVERY 8
+// Buffers de vértices: el pipeline OpenMP usa 2 (uno se envía mientras el
+// otro se llena); el grafo de tareas usa un anillo de GEO_RING para que el
+// llenado pueda adelantarse varios chunks al envío.
+#define GEO_RING 8
+// Esferas mínimas por tarea de llenado en el grafo
+#define GEO_PART 4096
 
-// Crece amortizadamente para 4 vértices y 6 índices por esfera
-static int ensure_capacity_geo(int N)
+static SDL_Vertex *g_chunk[GEO_RING] = {NULL};
+static Uint16 *g_index16 = NULL;
+
+#if defined(_OPENMP)
+static int ensure_geo_buffers(int nbuf)
 {
-    // 4 vértices y 6 índices por esfera
-    int needV = 4 * N, needI = 6 * N;
-    if (needV > g_verts_cap)
+    for (int b = 0; b < nbuf; ++b)
     {
-        int newV = (g_verts_cap == 0) ? (4 * 4096) : g_verts_cap;
-        while (newV < needV)
-            newV = (int)(newV * 1.5f);
-        SDL_Vertex *nv = (SDL_Vertex *)realloc(g_verts, (size_t)newV * sizeof(SDL_Vertex));
-        if (!nv)
+        if (!g_chunk[b])
+            g_chunk[b] = (SDL_Vertex *)malloc((size_t)4 * GEO_CHUNK * sizeof(SDL_Vertex));
+        if (!g_chunk[b])
             return 0;
-        g_verts = nv;
-        g_verts_cap = newV;
     }
-    if (needI > g_index_cap)
+    if (!g_index16)
     {
-        int newI = (g_index_cap == 0) ? (6 * 4096) : g_index_cap;
-        while (newI < needI)
-            newI = (int)(newI * 1.5f);
-        int *ni = (int *)realloc(g_index, (size_t)newI * sizeof(int));
-        if (!ni)
+        g_index16 = (Uint16 *)malloc((size_t)6 * GEO_CHUNK * sizeof(Uint16));
+        if (!g_index16)
             return 0;
-        g_index = ni;
-        g_index_cap = newI;
+        for (int q = 0; q < GEO_CHUNK; ++q)
+        {
+            Uint16 v = (Uint16)(4 * q);
+            Uint16 *ii = g_index16 + 6 * q;
+            ii[0] = v;
+            ii[1] = (Uint16)(v + 1);
+            ii[2] = (Uint16)(v + 2);
+            ii[3] = (Uint16)(v + 2);
+            ii[4] = (Uint16)(v + 3);
+            ii[5] = v;
+        }
     }
     return 1;
 }
 
+// Llena el chunk c (en el buffer c % nbuf) repartiendo sus esferas entre
+// 'nworkers' hilos; 'wid' es el índice de este hilo dentro de los que llenan.
+static void fill_chunk_part(const ClothState *S, size_t c, int nbuf, int wid, int nworkers)
+{
+    size_t q0 = c * GEO_CHUNK;
+    size_t cnt = S->N - q0;
+    if (cnt > GEO_CHUNK)
+        cnt = GEO_CHUNK;
+    size_t per = (cnt + (size_t)nworkers - 1) / (size_t)nworkers;
+    size_t a = (size_t)wid * per;
+    if (a >= cnt)
+        return;
+    size_t n = (a + per <= cnt) ? per : cnt - a;
+    SDL_Vertex *v = g_chunk[c % (size_t)nbuf] + 4 * a;
+    if (S->sorted)
+        cloth_kernels()->build_geo(v, S->sorted + q0 + a, NULL, n, S->tx, S->ty);
+    else
+        cloth_kernels()->build_geo(v, S->draw, S->order_idx + q0 + a, n, S->tx, S->ty);
+}
+
+static int submit_chunk(SDL_Renderer *R, const ClothState *S, size_t c, int nbuf)
+{
+    size_t q0 = c * GEO_CHUNK;
+    size_t cnt = S->N - q0;
+    if (cnt > GEO_CHUNK)
+        cnt = GEO_CHUNK;
+    const SDL_Vertex *v = g_chunk[c % (size_t)nbuf];
+    const int stride = (int)sizeof(SDL_Vertex);
+    return SDL_RenderGeometryRaw(R, S->sprite,
+                                 &v->position.x, stride, &v->color, stride, &v->tex_coord.x, stride,
+                                 (int)(4 * cnt), g_index16, (int)(6 * cnt), (int)sizeof(Uint16));
+}
+#endif
+
 // Renderizado paralelo de la tela
 void cloth_render_omp(SDL_Renderer *R, const ClothState *S)
 {
-    const int N = S->N;
 #if defined(_OPENMP)
-    if (N <= 0 || S->sprite == NULL || !ensure_capacity_geo(N))
+    const size_t N = S->N;
+    if (N == 0 || S->sprite == NULL || !ensure_geo_buffers(2))
     {
         cloth_render_seq(R, S);
         return;
     }
 
-    // Se encarga de la preparación de los vértices e índices
-#pragma omp parallel for schedule(static)
-    for (int q = 0; q < N; ++q)
-    {
-        int idx = S->order_idx[q];
-        const DrawItem *d = &S->draw[idx];
-
-        float x0 = (d->x + S->tx) - d->r;
-        float y0 = (d->y + S->ty) - d->r;
-        float x1 = x0 + 2.0f * d->r;
-        float y1 = y0 + 2.0f * d->r;
-
-        SDL_Color col = {d->r8, d->g8, d->b8, d->a8};
-        int v = 4 * q, ii = 6 * q;
-
-        g_verts[v + 0].position.x = x0;
-        g_verts[v + 0].position.y = y0;
-        g_verts[v + 0].color = col;
-        g_verts[v + 0].tex_coord.x = 0.f;
-        g_verts[v + 0].tex_coord.y = 0.f;
-
-        g_verts[v + 1].position.x = x1;
-        g_verts[v + 1].position.y = y0;
-        g_verts[v + 1].color = col;
-        g_verts[v + 1].tex_coord.x = 1.f;
-        g_verts[v + 1].tex_coord.y = 0.f;
-
-        g_verts[v + 2].position.x = x1;
-        g_verts[v + 2].position.y = y1;
-        g_verts[v + 2].color = col;
-        g_verts[v + 2].tex_coord.x = 1.f;
-        g_verts[v + 2].tex_coord.y = 1.f;
-
-        g_verts[v + 3].position.x = x0;
-        g_verts[v + 3].position.y = y1;
-        g_verts[v + 3].color = col;
-        g_verts[v + 3].tex_coord.x = 0.f;
-        g_verts[v + 3].tex_coord.y = 1.f;
-
-        g_index[ii + 0] = v + 0;
-        g_index[ii + 1] = v + 1;
-        g_index[ii + 2] = v + 2;
-        g_index[ii + 3] = v + 2;
-        g_index[ii + 4] = v + 3;
-        g_index[ii + 5] = v + 0;
-    }
+    const size_t nchunks = (N + GEO_CHUNK - 1) / GEO_CHUNK;
 
-    // Un solo draw call. Si el renderer no soporta geometry -> fallback.
-    if (SDL_RenderGeometry(R, S->sprite, g_verts, 4 * N, g_index, 6 * N) != 0)
+    // Una sola región por frame. Primero todos llenan el chunk 0; luego, en
+    // el paso c, el hilo 0 (el principal, dueño del renderer) envía el chunk
+    // c mientras el resto llena el c+1 en el otro buffer. La barrera de cada
+    // paso libera el buffer del chunk c para el llenado del c+2.
+    int failed = 0;
+#pragma omp parallel
     {
-        cloth_render_seq(R, S);
+        const int tid = omp_get_thread_num(), nt = omp_get_num_threads();
+        TraceSpan sp = trace_begin("geo-fill");
+        fill_chunk_part(S, 0, 2, tid, nt);
+        trace_end(sp);
+#pragma omp barrier
+        for (size_t c = 0; c < nchunks; ++c)
+        {
+            if (tid == 0)
+            {
+                sp = trace_begin("submit");
+                // Si el renderer no soporta geometry -> fallback (aún no se envió nada)
+                if (submit_chunk(R, S, c, 2) != 0 && c == 0)
+                    failed = 1;
+                else if (c > 0 && c % GEO_FLUSH_EVERY == 0)
+                    SDL_RenderFlush(R);
+                trace_end(sp);
+            }
+            if (c + 1 < nchunks && (nt == 1 || tid != 0))
+            {
+                sp = trace_begin("geo-fill");
+                if (nt == 1)
+                    fill_chunk_part(S, c + 1, 2, 0, 1);
+                else
+                    fill_chunk_part(S, c + 1, 2, tid - 1, nt - 1);
+                trace_end(sp);
+            }
+#pragma omp barrier
+            // Todos leen 'failed' después de la misma barrera: salen juntos
+            if (failed)
+                break;
+        }
     }
+    if (failed)
+        cloth_render_seq(R, S);
 #else
-    (void)R;
-    (void)S;
     // Si no hay OpenMP, siempre dibuja secuencial
     cloth_render_seq(R, S);
 #endif
 }
 
+#if defined(_OPENMP)
+// ---- Versión como grafo de tareas ----
+// GEO[c] (varias tareas por chunk) llena el buffer c % GEO_RING; SUBMIT[c]
+// es TG_MAIN y depende de su GEO y del SUBMIT anterior (el orden de dibujo se
+// respeta). GEO[c] espera a los tramos del orden que cubren sus posiciones y
+// a SUBMIT[c - GEO_RING] para reusar el buffer.
+static struct
+{
+    SDL_Renderer *R;
+    const ClothState *S;
+    size_t nchunks;
+    int nparts; // tareas de llenado por chunk
+    int failed; // el renderer rechazó el primer chunk
+} g_rg;
+
+static void task_geo(void *ctx, long c, long part)
+{
+    (void)ctx;
+    fill_chunk_part(g_rg.S, (size_t)c, GEO_RING, (int)part, g_rg.nparts);
+}
+
+static void task_submit(void *ctx, long c, long b)
+{
+    (void)ctx;
+    (void)b;
+    if (!g_rg.failed)
+    {
+        if (submit_chunk(g_rg.R, g_rg.S, (size_t)c, GEO_RING) != 0 && c == 0)
+            g_rg.failed = 1;
+        else if (c > 0 && c % GEO_FLUSH_EVERY == 0)
+            SDL_RenderFlush(g_rg.R);
+    }
+    // Fallback completo en el último envío (aún no se dibujó nada)
+    if (g_rg.failed && (size_t)c + 1 == g_rg.nchunks)
+        cloth_render_seq(g_rg.R, g_rg.S);
+}
+
+static void task_render_seq(void *ctx, long a, long b)
+{
+    (void)a;
+    (void)b;
+    cloth_render_seq(g_rg.R, (const ClothState *)ctx);
+}
+
+int cloth_render_graph(TaskGraph *G, SDL_Renderer *R, const ClothState *S, const ClothGraphDeps *deps)
+{
+    g_rg.R = R;
+    g_rg.S = S;
+    g_rg.failed = 0;
+    if (S->N == 0 || S->sprite == NULL || !ensure_geo_buffers(GEO_RING))
+        return tg_add(G, "render-seq", task_render_seq, (void *)S, 0, 0, TG_MAIN, deps->dep, deps->n);
+
+    const size_t nchunks = (S->N + GEO_CHUNK - 1) / GEO_CHUNK;
+    size_t per = (S->N < GEO_CHUNK) ? S->N : GEO_CHUNK;
+    g_rg.nchunks = nchunks;
+    g_rg.nparts = (int)((per + GEO_PART - 1) / GEO_PART);
+
+    int *submit = (int *)malloc(nchunks * sizeof(int));
+    if (!submit)
+        return tg_add(G, "render-seq", task_render_seq, (void *)S, 0, 0, TG_MAIN, deps->dep, deps->n);
+    int deps_sub[GEO_CHUNK / GEO_PART + 1];
+    int gdeps[CLOTH_TG_RANGES + 1];
+    for (size_t c = 0; c < nchunks; ++c)
+    {
+        // Tramos del orden que tocan las posiciones [q0, q1) de este chunk
+        int ng = 0;
+        if (deps->n > 0)
+        {
+            const size_t q0 = c * GEO_CHUNK;
+            const size_t q1 = (q0 + GEO_CHUNK < S->N) ? q0 + GEO_CHUNK : S->N;
+            size_t r1 = (q1 - 1) / deps->span;
+            if (r1 >= (size_t)deps->n)
+                r1 = (size_t)deps->n - 1;
+            for (size_t r = q0 / deps->span; r <= r1; ++r)
+                gdeps[ng++] = deps->dep[r];
+        }
+        gdeps[ng++] = (c >= GEO_RING) ? submit[c - GEO_RING] : -1;
+        for (int p = 0; p < g_rg.nparts; ++p)
+            deps_sub[p] = tg_add(G, "geometry", task_geo, NULL, (long)c, p, 0, gdeps, ng);
+        deps_sub[g_rg.nparts] = (c > 0) ? submit[c - 1] : -1;
+        submit[c] = tg_add(G, "submit", task_submit, NULL, (long)c, 0, TG_MAIN, deps_sub, g_rg.nparts + 1);
+    }
+    int last = submit[nchunks - 1];
+    free(submit);
+    return last;
+}
+#endif
+
 // Liberación explícita si quieres soltar buffers de geometry al salir
 void cloth_draw_omp_release(void)
 {
-    free(g_verts);
-    g_verts = NULL;
-    g_verts_cap = 0;
-    free(g_index);
-    g_index = NULL;
-    g_index_cap = 0;
+    for (int b = 0; b < GEO_RING; ++b)
+    {
+        free(g_chunk[b]);
+        g_chunk[b] = NULL;
+    }
+    free(g_index16);
+    g_index16 = NULL;
 }
@@ -1,21 +1,181 @@
 #include "cloth.h"
+#include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL.h>
 
+static inline const DrawItem *seq_item(const ClothState *S, size_t q)
+{
+    return S->sorted ? &S->sorted[q] : &S->draw[S->order_idx[q]];
+}
+
+static inline void seq_copy(SDL_Renderer *R, const ClothState *S, const DrawItem *d)
+{
+    const float r = draw_radius_lut[d->rcode];
+    float diam = r * 2.0f;
+    SDL_FRect dst = {(draw_dec_xy(d->x) + S->tx) - r, (draw_dec_xy(d->y) + S->ty) - r, diam, diam};
+
+    // Copia de textura al rectángulo de destino
+    SDL_RenderCopyF(R, S->sprite, NULL, &dst);
+}
+
+// ---- Modo paleta (P.palette > 0) ----
+// Cada cambio de color/alpha del sprite corta el batch de SDL, así que con
+// un color por esfera cada copia es un comando propio. Con la paleta, los
+// colores se cuantizan a L niveles por canal; dentro de cada bin de
+// profundidad las esferas se agrupan por color (counting sort estable) y cada
+// grupo va con un único color mod. El alpha no se cuantiza: se aplica el a8
+// de cada esfera y solo se llama a SDL cuando cambia (hoy es constante). El
+// orden entre bins se mantiene; dentro de un bin ya era arbitrario.
+// Sin límites de bin (estado interpolado) se agrupa por tramos de este tamaño
+// como máximo, cortados además donde cambia el bin de profundidad
+#define PAL_WINDOW 4096
+
+static uint16_t *g_pal_key = NULL; // clave por esfera de la ventana actual
+static uint32_t *g_pal_perm = NULL;
+static size_t g_pal_cap = 0;
+static uint32_t g_pal_cnt[6 * 6 * 6 + 1];
+
+static int ensure_palette(size_t n)
+{
+    if (n <= g_pal_cap)
+        return 1;
+    uint16_t *nk = (uint16_t *)realloc(g_pal_key, n * sizeof(uint16_t));
+    if (!nk)
+        return 0;
+    g_pal_key = nk;
+    uint32_t *np = (uint32_t *)realloc(g_pal_perm, n * sizeof(uint32_t));
+    if (!np)
+        return 0;
+    g_pal_perm = np;
+    g_pal_cap = n;
+    return 1;
+}
+
+// Niveles por canal para ~K colores (2..6, es decir 8..216 colores)
+static int palette_levels(int K)
+{
+    int L = 2;
+    while (L < 6 && (L + 1) * (L + 1) * (L + 1) <= K)
+        L++;
+    return L;
+}
+
+static inline int quant(unsigned v, int L)
+{
+    return (int)((v * (unsigned)(L - 1) + 127u) / 255u);
+}
+
+static inline Uint8 dequant(int q, int L)
+{
+    return (Uint8)((q * 255 + (L - 1) / 2) / (L - 1));
+}
+
+static void render_group_window(SDL_Renderer *R, const ClothState *S, size_t q0, size_t q1, int L)
+{
+    const size_t n = q1 - q0;
+    const int nkeys = L * L * L;
+    memset(g_pal_cnt, 0, sizeof(uint32_t) * (size_t)(nkeys + 1));
+    for (size_t i = 0; i < n; ++i)
+    {
+        const DrawItem *d = seq_item(S, q0 + i);
+        unsigned char r8, g8, b8;
+        draw_dec_rgb(d->rgb565, &r8, &g8, &b8);
+        const int key = (quant(r8, L) * L + quant(g8, L)) * L + quant(b8, L);
+        g_pal_key[i] = (uint16_t)key;
+        g_pal_cnt[key + 1]++;
+    }
+    for (int k = 0; k < nkeys; ++k)
+        g_pal_cnt[k + 1] += g_pal_cnt[k];
+    // Tras el scatter g_pal_cnt[k] es el fin del grupo k
+    for (size_t i = 0; i < n; ++i)
+        g_pal_perm[g_pal_cnt[g_pal_key[i]]++] = (uint32_t)i;
+
+    size_t i = 0;
+    int alpha = -1;
+    while (i < n)
+    {
+        const int c = g_pal_key[g_pal_perm[i]];
+        SDL_SetTextureColorMod(S->sprite, dequant(c / (L * L), L), dequant((c / L) % L, L), dequant(c % L, L));
+        const size_t end = g_pal_cnt[c];
+        for (; i < end; ++i)
+        {
+            const DrawItem *d = seq_item(S, q0 + g_pal_perm[i]);
+            if (d->a8 != alpha)
+            {
+                alpha = d->a8;
+                SDL_SetTextureAlphaMod(S->sprite, d->a8);
+            }
+            seq_copy(R, S, d);
+        }
+    }
+}
+
+static int render_seq_palette(SDL_Renderer *R, const ClothState *S)
+{
+    const int L = palette_levels(S->P.palette);
+    const size_t N = S->N;
+    if (S->bin_start && S->nbins > 0)
+    {
+        size_t maxbin = 0;
+        for (int b = 0; b < S->nbins; ++b)
+        {
+            const size_t e = (b + 1 < S->nbins) ? S->bin_start[b + 1] : N;
+            if (e - S->bin_start[b] > maxbin)
+                maxbin = e - S->bin_start[b];
+        }
+        if (!ensure_palette(maxbin))
+            return 0;
+        for (int b = 0; b < S->nbins; ++b)
+        {
+            const size_t e = (b + 1 < S->nbins) ? S->bin_start[b + 1] : N;
+            if (e > S->bin_start[b])
+                render_group_window(R, S, S->bin_start[b], e, L);
+        }
+        return 1;
+    }
+    // Sin profundidad por esfera (--view, --replay) no hay forma de saber qué
+    // se puede reagrupar sin romper el orden de pintor: dibujo normal
+    if (S->sorted || !S->order_idx || !S->depth || N == 0 || !ensure_palette(PAL_WINDOW))
+        return 0;
+    // Mismos bins que el bucket sort, sobre el rango de claves del estado
+    unsigned kmin = 65535u, kmax = 0u;
+    for (size_t k = 0; k < N; ++k)
+    {
+        kmin = S->depth[k] < kmin ? S->depth[k] : kmin;
+        kmax = S->depth[k] > kmax ? S->depth[k] : kmax;
+    }
+    const unsigned nb = (S->nbins > 0) ? (unsigned)S->nbins : 128u;
+    const unsigned range = kmax > kmin ? kmax - kmin : 1u;
+#define PAL_BIN(q) ((((unsigned)S->depth[S->order_idx[q]] - kmin) * (nb - 1u) + range / 2u) / range)
+    size_t q = 0;
+    while (q < N)
+    {
+        const unsigned b = PAL_BIN(q);
+        size_t e = q + 1;
+        while (e < N && e - q < PAL_WINDOW && PAL_BIN(e) == b)
+            e++;
+        render_group_window(R, S, q, e, L);
+        q = e;
+    }
+#undef PAL_BIN
+    return 1;
+}
+
 // Renderizado secuencial de la tela
 void cloth_render_seq(SDL_Renderer *R, const ClothState *S)
 {
-    const int N = S->N;
-    for (int q = 0; q < N; ++q)
+    if (S->P.palette > 0 && render_seq_palette(R, S))
+        return;
+    const size_t N = S->N;
+    for (size_t q = 0; q < N; ++q)
     {
-        const DrawItem *d = &S->draw[S->order_idx[q]];
+        const DrawItem *d = seq_item(S, q);
 
         // Modulación de color y alpha
-        SDL_SetTextureColorMod(S->sprite, d->r8, d->g8, d->b8);
+        unsigned char r8, g8, b8;
+        draw_dec_rgb(d->rgb565, &r8, &g8, &b8);
+        SDL_SetTextureColorMod(S->sprite, r8, g8, b8);
         SDL_SetTextureAlphaMod(S->sprite, d->a8);
-        float diam = d->r * 2.0f;
-        SDL_FRect dst = {(d->x + S->tx) - d->r, (d->y + S->ty) - d->r, diam, diam};
-
-        // Copia de textura al rectángulo de destino
-        SDL_RenderCopyF(R, S->sprite, NULL, &dst);
+        seq_copy(R, S, d);
     }
 }
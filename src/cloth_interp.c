@@ -0,0 +1,382 @@
+#include "cloth.h"
+#include "cloth_kernels.h"
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Pasadas par-impar como máximo en la reparación local del orden
+#define INTERP_SORT_PASSES 2
+
+// Buffers del resultado interpolado: crecen con N y se reusan entre frames
+static int ensure_capacity_interp(ClothInterp *I, size_t N)
+{
+    if (N <= I->cap)
+        return 1;
+    DrawItem *no = (DrawItem *)realloc(I->out, N * sizeof(DrawItem));
+    if (!no)
+        return 0;
+    I->out = no;
+    uint16_t *nd = (uint16_t *)realloc(I->out_depth, N * sizeof(uint16_t));
+    if (!nd)
+        return 0;
+    I->out_depth = nd;
+    int *nr = (int *)realloc(I->order, N * sizeof(int));
+    if (!nr)
+        return 0;
+    I->order = nr;
+    uint8_t *nb = (uint8_t *)realloc(I->bin, N);
+    if (!nb)
+        return 0;
+    I->bin = nb;
+    I->cap = N;
+    return 1;
+}
+
+static void drop_states(ClothInterp *I)
+{
+    free(I->prev_draw);
+    free(I->curr_draw);
+    free(I->prev_depth);
+    free(I->curr_depth);
+    I->prev_draw = I->curr_draw = NULL;
+    I->prev_depth = I->curr_depth = NULL;
+    I->nstates = 0;
+    I->state_cap = 0;
+}
+
+// Los estados guardados siguen a la capacidad de S: cloth_resize reserva en
+// los frames previos al cambio y acá se copian en el push siguiente, así el
+// frame que adopta la malla nueva no reserva nada
+static int grow_states(ClothInterp *I, const ClothState *S)
+{
+    const size_t cap = S->draw_cap;
+    if (I->state_cap >= cap)
+        return 1;
+    DrawItem **draws[2] = {&I->prev_draw, &I->curr_draw};
+    uint16_t **depths[2] = {&I->prev_depth, &I->curr_depth};
+    for (int k = 0; k < 2; ++k)
+    {
+        if (*draws[k])
+        {
+            DrawItem *nd = (DrawItem *)realloc(*draws[k], cap * sizeof(DrawItem));
+            if (!nd)
+                return 0;
+            *draws[k] = nd;
+        }
+        if (*depths[k])
+        {
+            uint16_t *nz = (uint16_t *)realloc(*depths[k], cap * sizeof(uint16_t));
+            if (!nz)
+                return 0;
+            *depths[k] = nz;
+        }
+    }
+    if (I->curr_order && I->curr_order_cap < S->order_cap)
+    {
+        int *no = (int *)realloc(I->curr_order, S->order_cap * sizeof(int));
+        if (!no)
+            return 0;
+        I->curr_order = no;
+        I->curr_order_cap = S->order_cap;
+    }
+    I->state_cap = cap;
+    return 1;
+}
+
+int cloth_interp_push(ClothInterp *I, ClothState *S, double t)
+{
+    const size_t N = S->N;
+    if (N != I->N)
+    {
+        // Cambió la grilla: los estados anteriores ya no son comparables,
+        // pero sus buffers (con la capacidad de S) se reusan
+        I->nstates = 0;
+        I->N = N;
+    }
+    if (!grow_states(I, S) || !ensure_capacity_interp(I, S->draw_cap))
+        return 0;
+
+    // Buffer libre para el próximo cloth_update: el estado más viejo. Los
+    // nuevos se reservan con la capacidad de S (puede crecer con cloth_resize).
+    DrawItem *spare_draw = I->prev_draw;
+    uint16_t *spare_depth = I->prev_depth;
+    if (!spare_draw)
+        spare_draw = (DrawItem *)malloc(S->draw_cap * sizeof(DrawItem));
+    if (!spare_depth)
+        spare_depth = (uint16_t *)malloc(S->draw_cap * sizeof(uint16_t));
+    if (!spare_draw || !spare_depth)
+    {
+        if (spare_draw != I->prev_draw)
+            free(spare_draw);
+        if (spare_depth != I->prev_depth)
+            free(spare_depth);
+        return 0;
+    }
+
+    I->prev_draw = I->curr_draw;
+    I->prev_depth = I->curr_depth;
+    I->prev_tx = I->curr_tx;
+    I->prev_ty = I->curr_ty;
+    I->prev_t = I->curr_t;
+
+    I->curr_draw = S->draw;
+    I->curr_depth = S->depth;
+    I->curr_tx = S->tx;
+    I->curr_ty = S->ty;
+    I->curr_t = t;
+    if (I->nstates < 2)
+        I->nstates++;
+
+    S->draw = spare_draw;
+    S->depth = spare_depth;
+    // El orden también rota: cloth_update lo reserva si el que recibe es chico
+    int *so = S->order_idx;
+    const size_t so_cap = S->order_cap;
+    S->order_idx = I->curr_order;
+    S->order_cap = I->curr_order_cap;
+    I->curr_order = so;
+    I->curr_order_cap = so_cap;
+    return 1;
+}
+
+static inline unsigned char lerp_u8(unsigned char a, unsigned char b, float w)
+{
+    return (unsigned char)((float)a + ((float)b - (float)a) * w + 0.5f);
+}
+
+// Los campos cuantizados se interpolan en su propia escala (x/y y la clave de
+// profundidad son lineales; el código del radio es logarítmico, lo que da una
+// interpolación geométrica del radio, indistinguible a un subpaso).
+static inline uint16_t lerp_u16(uint16_t a, uint16_t b, float w)
+{
+    return (uint16_t)((float)a + ((float)b - (float)a) * w + 0.5f);
+}
+
+static inline uint16_t lerp_565(uint16_t a, uint16_t b, float w)
+{
+    unsigned char r0, g0, b0, r1, g1, b1;
+    draw_dec_rgb(a, &r0, &g0, &b0);
+    draw_dec_rgb(b, &r1, &g1, &b1);
+    return draw_enc_rgb(lerp_u8(r0, r1, w), lerp_u8(g0, g1, w), lerp_u8(b0, b1, w));
+}
+
+void cloth_interp_view(ClothInterp *I, const ClothState *S, double t, ClothState *view)
+{
+    *view = *S;
+    // S->sorted es del último paso de simulación, no del estado interpolado
+    view->sorted = NULL;
+    view->bin_start = NULL; // la reparación del orden mueve los bordes
+    if (I->nstates == 0)
+        return;
+
+    const size_t N = I->N;
+    view->N = N;
+    view->depth = I->curr_depth;
+    view->tx = I->curr_tx;
+    view->ty = I->curr_ty;
+    if (I->nstates < 2 || I->curr_t <= I->prev_t)
+    {
+        view->draw = I->curr_draw;
+        view->order_idx = I->curr_order;
+        return;
+    }
+
+    double a = (t - I->prev_t) / (I->curr_t - I->prev_t);
+    if (a < 0.0)
+        a = 0.0;
+    else if (a > 1.0)
+        a = 1.0;
+    const float w = (float)a;
+
+    const DrawItem *p0 = I->prev_draw, *p1 = I->curr_draw;
+    const uint16_t *z0 = I->prev_depth, *z1 = I->curr_depth;
+    DrawItem *out = I->out;
+    uint16_t *zo = I->out_depth;
+
+    // Una sola pasada lineal sobre ambos estados (vectorizable); de paso, el
+    // rango de claves interpoladas y cuánto se alejan del estado nuevo
+    unsigned kmin = 65535u, kmax = 0u, drift = 0u;
+#ifdef _OPENMP
+#pragma omp parallel for simd schedule(static) reduction(min : kmin) reduction(max : kmax, drift)
+#endif
+    for (size_t k = 0; k < N; ++k)
+    {
+        out[k].x = lerp_u16(p0[k].x, p1[k].x, w);
+        out[k].y = lerp_u16(p0[k].y, p1[k].y, w);
+        out[k].rgb565 = lerp_565(p0[k].rgb565, p1[k].rgb565, w);
+        out[k].rcode = lerp_u8(p0[k].rcode, p1[k].rcode, w);
+        out[k].a8 = lerp_u8(p0[k].a8, p1[k].a8, w);
+        const unsigned z = lerp_u16(z0[k], z1[k], w);
+        zo[k] = (uint16_t)z;
+        kmin = z < kmin ? z : kmin;
+        kmax = z > kmax ? z : kmax;
+        const unsigned dz = z > z1[k] ? z - z1[k] : z1[k] - z;
+        drift = dz > drift ? dz : drift;
+    }
+
+    int *ord = I->order;
+    const int nbins = (S->nbins > 0 && S->nbins <= 256) ? S->nbins : 128;
+    const unsigned range = kmax > kmin ? kmax - kmin : 1u;
+    if ((size_t)drift * (size_t)nbins <= (size_t)range)
+    {
+        // Ninguna clave se movió más de un bin respecto del estado nuevo: el
+        // desorden es local y se repara con pasadas par-impar de intercambios
+        // adyacentes, hasta INTERP_SORT_PASSES o hasta que no haya cambios.
+        memcpy(ord, I->curr_order, N * sizeof(int));
+        const size_t last = N - 1; // N >= 1 si hay estados
+        size_t swaps = 1;
+        for (int pass = 0; pass < INTERP_SORT_PASSES && swaps > 0; ++pass)
+        {
+            swaps = 0;
+            for (int phase = 0; phase < 2; ++phase)
+            {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+ : swaps)
+#endif
+                for (size_t q = (size_t)phase; q < last; q += 2)
+                {
+                    int i0 = ord[q], i1 = ord[q + 1];
+                    if (zo[i0] > zo[i1])
+                    {
+                        ord[q] = i1;
+                        ord[q + 1] = i0;
+                        swaps++;
+                    }
+                }
+            }
+        }
+    }
+    else
+    {
+        // Las claves derivaron más de un bin (pasos de simulación largos o
+        // movimiento rápido en z): intercambios locales no alcanzan y se
+        // rehace el orden con los mismos bins que el bucket sort del update.
+        cloth_kernels()->bin_index(zo, I->bin, N, (float)kmin, (float)(nbins - 1) / (float)range, nbins, 1);
+        size_t pos[257] = {0};
+        for (size_t k = 0; k < N; ++k)
+            pos[I->bin[k] + 1]++;
+        for (int b = 0; b < nbins; ++b)
+            pos[b + 1] += pos[b];
+        // Estable respecto del orden del estado nuevo
+        for (size_t q = 0; q < N; ++q)
+        {
+            const int i = I->curr_order[q];
+            ord[pos[I->bin[i]]++] = i;
+        }
+        I->rebins++;
+    }
+
+    view->draw = out;
+    view->depth = zo;
+    view->order_idx = ord;
+    view->tx = I->prev_tx + (I->curr_tx - I->prev_tx) * w;
+    view->ty = I->prev_ty + (I->curr_ty - I->prev_ty) * w;
+}
+
+void cloth_interp_release(ClothInterp *I)
+{
+    drop_states(I);
+    free(I->out);
+    free(I->out_depth);
+    free(I->order);
+    free(I->bin);
+    free(I->curr_order);
+    memset(I, 0, sizeof(*I));
+}
+
+struct ClothSim
+{
+    ClothState *S;
+    SDL_Thread *thr;
+    SDL_sem *go, *done;
+    // Pedido en curso (lo escribe el hilo de render antes de SDL_SemPost)
+    int W, H, threads;
+    float t;
+    int quit;
+    int busy; // solo hilo de render
+};
+
+static int sim_main(void *arg)
+{
+    ClothSim *M = (ClothSim *)arg;
+    trace_thread_name("sim");
+#ifdef _OPENMP
+    int threads = 0;
+#endif
+    for (;;)
+    {
+        SDL_SemWait(M->go);
+        if (M->quit)
+            break;
+#ifdef _OPENMP
+        // El número de hilos de OpenMP es por hilo: se sigue el del render
+        if (M->threads > 0 && M->threads != threads)
+            omp_set_num_threads(M->threads);
+        threads = M->threads;
+#endif
+        TraceSpan sp = trace_begin("sim-update");
+        cloth_update(NULL, M->S, M->W, M->H, M->t);
+        trace_end(sp);
+        SDL_SemPost(M->done);
+    }
+    return 0;
+}
+
+ClothSim *cloth_sim_start(ClothState *S)
+{
+    ClothSim *M = (ClothSim *)calloc(1, sizeof(ClothSim));
+    if (!M)
+        return NULL;
+    M->S = S;
+    M->go = SDL_CreateSemaphore(0);
+    M->done = SDL_CreateSemaphore(0);
+    if (M->go && M->done)
+        M->thr = SDL_CreateThread(sim_main, "sim", M);
+    if (!M->thr)
+    {
+        if (M->go)
+            SDL_DestroySemaphore(M->go);
+        if (M->done)
+            SDL_DestroySemaphore(M->done);
+        free(M);
+        return NULL;
+    }
+    return M;
+}
+
+void cloth_sim_kick(ClothSim *M, int W, int H, float t, int threads)
+{
+    cloth_sim_wait(M);
+    M->W = W;
+    M->H = H;
+    M->t = t;
+    M->threads = threads;
+    M->busy = 1;
+    SDL_SemPost(M->go);
+}
+
+void cloth_sim_wait(ClothSim *M)
+{
+    if (!M || !M->busy)
+        return;
+    SDL_SemWait(M->done);
+    M->busy = 0;
+}
+
+void cloth_sim_stop(ClothSim *M)
+{
+    if (!M)
+        return;
+    cloth_sim_wait(M);
+    M->quit = 1;
+    SDL_SemPost(M->go);
+    SDL_WaitThread(M->thr, NULL);
+    SDL_DestroySemaphore(M->go);
+    SDL_DestroySemaphore(M->done);
+    free(M);
+}
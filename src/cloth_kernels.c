@@ -0,0 +1,216 @@
+// Kernels calientes de la tela. Este archivo se compila una vez por ISA
+// (ver Makefile: -DKERN_ISA=sse2|avx2|avx512 con sus -m...) y cada objeto
+// exporta la tabla cloth_kernels_<isa>; cpu_dispatch.c elige una al arrancar.
+#include "cloth_kernels.h"
+#include "cloth_math.h"
+#include "trace.h"
+#include <math.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef KERN_ISA
+#define KERN_ISA generic
+#endif
+#define KCAT2(a, b) a##_##b
+#define KCAT(a, b) KCAT2(a, b)
+#define KSTR2(a) #a
+#define KSTR(a) KSTR2(a)
+
+// Proyecta cada punto de la malla, calcula radio/color y min/max de profundidad
+static void update_points(ClothUpdateArgs *a)
+{
+    const int GX = a->GX, W = a->W, H = a->H, j0 = a->j0, j1 = a->j1;
+    const float t = a->t;
+    const float *gX = a->X, *gY = a->Y;
+    const float tiltX = a->tiltX, tiltY = a->tiltY, zCam = a->zCam, fov = a->fov;
+    const float amp = a->amp, inv2sig2 = a->inv2sig2, omg = a->omg, cs = a->cs;
+    const float cx = a->cx, cy = a->cy, baseRadius = a->baseRadius;
+    const float zlo = a->zlo, zscale = a->zscale;
+    DrawItem *draw = a->draw;
+    uint16_t *depth = a->depth;
+
+    // Onda base + gaussiana radial
+    const float kx = 2.2f, ky = 1.7f;
+
+    unsigned kmin = 65535u, kmax = 0u;
+    // Visibles: el área W x H llevada a coordenadas sin paneo
+    const float vx0 = -a->tx, vx1 = (float)W - a->tx, vy0 = -a->ty, vy1 = (float)H - a->ty;
+    size_t vis = 0;
+
+#ifdef _OPENMP
+// Para calcular la profundidad de cada punto, min/max de profundidad y las
+// visibles. La región se abre aparte del for para trazar el tramo de cada hilo.
+#pragma omp parallel reduction(min : kmin) reduction(max : kmax) reduction(+ : vis) if (a->par)
+#endif
+    {
+        TraceSpan sp = trace_begin("update");
+#ifdef _OPENMP
+#pragma omp for collapse(2) schedule(static) nowait
+#endif
+        for (int j = j0; j < j1; ++j)
+        {
+            for (int i = 0; i < GX; ++i)
+            {
+                size_t idx = (size_t)j * (size_t)GX + (size_t)i;
+
+                float X = gX[idx];
+                float Y = gY[idx];
+
+                float base = 0.22f * sinf(kx * X + 0.7f * t) * cosf(ky * Y + 0.9f * t);
+                float dx = X - cx, dy = Y - cy;
+                float r2 = dx * dx + dy * dy;
+                float g = expf(-(r2)*inv2sig2);
+                float Z = base + amp * g * sinf(omg * t + r2 * 0.6f);
+
+                Vec3 P = {X, Y, 2.0f + Z};
+                P = rotX(P, tiltX);
+                P = rotY(P, tiltY);
+
+                // Profundidad como clave de 16 bits (el rango lo acota prepare_update)
+                const float zq = fminf(fmaxf((P.z - zlo) * zscale, 0.f), 65535.f);
+                const unsigned key = (unsigned)(zq + 0.5f);
+                depth[idx] = (uint16_t)key;
+                if (key < kmin)
+                    kmin = key;
+                if (key > kmax)
+                    kmax = key;
+
+                Vec2 Scr = project_point(P, W, H, fov, zCam);
+                float denom = (P.z - zCam);
+                if (UNLIKELY(fabsf(denom) < 1e-4f))
+                    denom = (denom >= 0.f ? 1e-4f : -1e-4f);
+                float scale = fov / denom;
+                float radius = baseRadius * clampf(scale * 0.9f, 0.5f, 2.1f);
+                vis += (Scr.x + radius > vx0 && Scr.x - radius < vx1 && Scr.y + radius > vy0 &&
+                        Scr.y - radius < vy1);
+
+                float u = ((float)i / (float)(GX - 1)) * 2.0f - 1.0f;
+                float hue = 0.6f + 0.25f * Z + cs * t + 0.08f * u;
+                unsigned char R8, G8, B8;
+                hsv_to_rgb(hue, 0.8f, 0.95f, &R8, &G8, &B8);
+
+                DrawItem di;
+                di.x = draw_enc_xy(Scr.x);
+                di.y = draw_enc_xy(Scr.y);
+                di.rgb565 = draw_enc_rgb(R8, G8, B8);
+                di.rcode = draw_enc_r(radius);
+                di.a8 = 220;
+                draw[idx] = di;
+            }
+        }
+        trace_end(sp);
+    }
+    a->kmin = kmin;
+    a->kmax = kmax;
+    a->visible = vis;
+}
+
+// Índice de bin de profundidad por partícula (primera fase del bucket sort)
+static void bin_index(const uint16_t *depth, uint8_t *bin, size_t N, float kmin, float invRange, int nbins,
+                      int par)
+{
+    (void)par;
+#ifdef _OPENMP
+#pragma omp parallel if (par)
+#endif
+    {
+        TraceSpan sp = trace_begin("bin-index");
+#ifdef _OPENMP
+#pragma omp for schedule(static) nowait
+#endif
+        for (size_t k = 0; k < N; ++k)
+        {
+            int b = (int)(((float)depth[k] - kmin) * invRange + 0.5f);
+            if (b < 0)
+                b = 0;
+            else if (b >= nbins)
+                b = nbins - 1;
+            bin[k] = (uint8_t)b;
+        }
+        trace_end(sp);
+    }
+}
+
+// 4 vértices por esfera, en el orden de dibujo. Es serial: el llamador reparte
+// tramos entre hilos (cloth_draw_omp.c solapa el llenado con el envío).
+// Los índices son siempre el mismo patrón por chunk y no se escriben aquí.
+// order == NULL: draw ya está en orden de dibujo y se lee en forma lineal.
+static void build_geo(SDL_Vertex *verts, const DrawItem *draw, const int *order,
+                      size_t count, float tx, float ty)
+{
+    for (size_t q = 0; q < count; ++q)
+    {
+        const DrawItem *d = order ? &draw[order[q]] : &draw[q];
+
+        // Decodificación al vuelo del formato compacto
+        const float r = draw_radius_lut[d->rcode];
+        float x0 = (draw_dec_xy(d->x) + tx) - r;
+        float y0 = (draw_dec_xy(d->y) + ty) - r;
+        float x1 = x0 + 2.0f * r;
+        float y1 = y0 + 2.0f * r;
+
+        SDL_Color col;
+        draw_dec_rgb(d->rgb565, &col.r, &col.g, &col.b);
+        col.a = d->a8;
+        size_t v = 4 * q;
+
+        verts[v + 0].position.x = x0;
+        verts[v + 0].position.y = y0;
+        verts[v + 0].color = col;
+        verts[v + 0].tex_coord.x = 0.f;
+        verts[v + 0].tex_coord.y = 0.f;
+
+        verts[v + 1].position.x = x1;
+        verts[v + 1].position.y = y0;
+        verts[v + 1].color = col;
+        verts[v + 1].tex_coord.x = 1.f;
+        verts[v + 1].tex_coord.y = 0.f;
+
+        verts[v + 2].position.x = x1;
+        verts[v + 2].position.y = y1;
+        verts[v + 2].color = col;
+        verts[v + 2].tex_coord.x = 1.f;
+        verts[v + 2].tex_coord.y = 1.f;
+
+        verts[v + 3].position.x = x0;
+        verts[v + 3].position.y = y1;
+        verts[v + 3].color = col;
+        verts[v + 3].tex_coord.x = 0.f;
+        verts[v + 3].tex_coord.y = 1.f;
+    }
+}
+
+// Sprite ARGB8888 (2r x 2r) con alpha suave y un highlight leve
+static void sprite(Uint32 *buf, int radius)
+{
+    const int d = radius * 2;
+    const float rad = (float)radius;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (d >= 128)
+#endif
+    for (int y = 0; y < d; ++y)
+    {
+        Uint32 *row = buf + y * d;
+        for (int x = 0; x < d; ++x)
+        {
+            float dx = ((float)x + 0.5f - rad), dy = ((float)y + 0.5f - rad);
+            float r = sqrtf(dx * dx + dy * dy) / rad;       // 0..1
+            float alpha = clampf(1.0f - r * r, 0.0f, 1.0f); // borde suave
+            float sx = (dx + dy * 0.3f) / rad;
+            float spec = clampf(0.9f - (sx * sx + dy * dy / (rad * rad)) * 1.2f, 0.0f, 1.0f) * 0.3f;
+            Uint32 A = (Uint32)(alpha * 255.f);
+            Uint32 c = (Uint32)(spec * 255.f);
+            row[x] = (A << 24) | (c << 16) | (c << 8) | c; // ARGB
+        }
+    }
+}
+
+const ClothKernels KCAT(cloth_kernels, KERN_ISA) = {
+    KSTR(KERN_ISA),
+    update_points,
+    bin_index,
+    build_geo,
+    sprite,
+};
@@ -0,0 +1,58 @@
+#ifndef CLOTH_KERNELS_H
+#define CLOTH_KERNELS_H
+
+#include <SDL2/SDL.h>
+#include "sim.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Entradas del kernel de update (todo lo que el bucle por punto necesita)
+    typedef struct
+    {
+        int GX, GY;
+        int W, H;
+        float t;
+        const float *X, *Y; // malla base
+        float tiltX, tiltY, zCam, fov;
+        float amp, inv2sig2, omg, cs;
+        float cx, cy; // centro animado de la perturbación
+        float baseRadius;
+        float zlo, zscale;   // clave = (z - zlo) * zscale, acotada a 16 bits
+        DrawItem *draw;      // salida
+        uint16_t *depth;     // salida: clave de profundidad
+        unsigned kmin, kmax; // salida: rango de claves
+        float tx, ty;        // paneo con que se cuentan las visibles
+        size_t visible;      // salida: esferas cuyo disco toca el área W x H
+        int j0, j1;          // filas [j0, j1) a procesar
+        int par;             // 1 = el kernel abre su propia región paralela
+    } ClothUpdateArgs;
+
+    // Tabla de kernels calientes. cloth_kernels.c se compila una vez por ISA
+    // (SSE2, AVX2, AVX-512) y cada variante exporta su propia tabla.
+    typedef struct
+    {
+        const char *name;
+        void (*update_points)(ClothUpdateArgs *a);
+        void (*bin_index)(const uint16_t *depth, uint8_t *bin, size_t N, float kmin, float invRange, int nbins,
+                          int par);
+        // Serial sobre un tramo: 4 vértices por esfera de order[0..count), o
+        // de draw[0..count) si order es NULL (draw ya en orden de dibujo)
+        void (*build_geo)(SDL_Vertex *verts, const DrawItem *draw, const int *order,
+                          size_t count, float tx, float ty);
+        void (*sprite)(Uint32 *buf, int radius);
+    } ClothKernels;
+
+    // Selecciona la variante: "auto" (cpuid), "sse2", "avx2" o "avx512".
+    // Imprime una línea con la elección. Devuelve 0 si la ISA pedida no existe
+    // o la CPU no la soporta (en ese caso se queda con la mejor disponible).
+    int cloth_kernels_select(const char *isa);
+    // Tabla activa (autoselección perezosa si nadie llamó a cloth_kernels_select)
+    const ClothKernels *cloth_kernels(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,113 @@
+#ifndef CLOTH_MATH_H
+#define CLOTH_MATH_H
+
+// Utilidades matemáticas internas compartidas por cloth_core.c y los kernels.
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#ifndef LIKELY
+#define LIKELY(x) __builtin_expect(!!(x), 1)
+#define UNLIKELY(x) __builtin_expect(!!(x), 0)
+#endif
+
+// Funciones auxiliares: clamp rápido y conversión HSV a RGB para paletas suaves
+static inline float clampf(float v, float a, float b) { return fminf(fmaxf(v, a), b); }
+
+static inline void hsv_to_rgb(float h, float s, float v,
+                              unsigned char *R, unsigned char *G, unsigned char *B)
+{
+    h -= floorf(h);      // hue envuelto a [0, 1)
+    float hf = h * 6.0f; // 6 sectores
+    int i = (int)floorf(hf);
+    float f = hf - (float)i;
+    float p = v * (1.0f - s);
+    float q = v * (1.0f - f * s);
+    float t = v * (1.0f - (1.0f - f) * s);
+    float r, g, b;
+    // Esto sirve para interpolación de colores
+    switch (i % 6)
+    {
+    case 0:
+        r = v;
+        g = t;
+        b = p;
+        break;
+    case 1:
+        r = q;
+        g = v;
+        b = p;
+        break;
+    case 2:
+        r = p;
+        g = v;
+        b = t;
+        break;
+    case 3:
+        r = p;
+        g = q;
+        b = v;
+        break;
+    case 4:
+        r = t;
+        g = p;
+        b = v;
+        break;
+    default:
+        r = v;
+        g = p;
+        b = q;
+        break;
+    }
+    r = clampf(r, 0.f, 1.f);
+    g = clampf(g, 0.f, 1.f);
+    b = clampf(b, 0.f, 1.f);
+    *R = (unsigned char)(r * 255.f);
+    *G = (unsigned char)(g * 255.f);
+    *B = (unsigned char)(b * 255.f);
+}
+
+// Tipos simples para 3D/2D y rotaciones elementales
+typedef struct
+{
+    float x, y, z;
+} Vec3;
+typedef struct
+{
+    float x, y;
+} Vec2;
+
+static inline Vec3 rotX(Vec3 v, float ang)
+{
+    float c = cosf(ang), s = sinf(ang);
+    Vec3 r;
+    r.x = v.x;
+    r.y = v.y * c - v.z * s;
+    r.z = v.y * s + v.z * c;
+    return r;
+}
+static inline Vec3 rotY(Vec3 v, float ang)
+{
+    float c = cosf(ang), s = sinf(ang);
+    Vec3 r;
+    r.x = v.x * c + v.z * s;
+    r.y = v.y;
+    r.z = -v.x * s + v.z * c;
+    return r;
+}
+
+// Proyección perspectiva con protección frente a denominadores casi cero
+static inline Vec2 project_point(Vec3 v, int W, int H, float fov, float zCam)
+{
+    float denom = (v.z - zCam);
+    if (UNLIKELY(fabsf(denom) < 1e-4f))
+        denom = (denom >= 0.f ? 1e-4f : -1e-4f);
+    float scale = fov / denom;
+    float hw = 0.5f * (float)W, hh = 0.5f * (float)H;
+    Vec2 out = {v.x * scale * hw + hw, v.y * scale * hh + hh};
+    return out;
+}
+
+#endif
@@ -0,0 +1,110 @@
+#include "cloth_kernels.h"
+#include <stdio.h>
+#include <string.h>
+
+// Tablas exportadas por cada compilación de cloth_kernels.c (ver Makefile)
+#if defined(__x86_64__) || defined(__i386__)
+#define CLOTH_X86_KERNELS 1
+extern const ClothKernels cloth_kernels_sse2;
+extern const ClothKernels cloth_kernels_avx2;
+extern const ClothKernels cloth_kernels_avx512;
+#else
+extern const ClothKernels cloth_kernels_generic;
+#endif
+
+typedef struct
+{
+    const char *name;
+    const ClothKernels *table;
+    int (*supported)(void);
+} IsaEntry;
+
+#ifdef CLOTH_X86_KERNELS
+static int has_sse2(void) { return 1; } // base de x86-64
+static int has_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+static int has_avx512(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+           __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq") && has_avx2();
+}
+
+// De peor a mejor: "auto" elige la última soportada
+static const IsaEntry g_isas[] = {
+    {"sse2", &cloth_kernels_sse2, has_sse2},
+    {"avx2", &cloth_kernels_avx2, has_avx2},
+    {"avx512", &cloth_kernels_avx512, has_avx512},
+};
+#else
+static int has_generic(void) { return 1; }
+static const IsaEntry g_isas[] = {
+    {"generic", &cloth_kernels_generic, has_generic},
+};
+#endif
+
+#define NUM_ISAS ((int)(sizeof(g_isas) / sizeof(g_isas[0])))
+
+static const ClothKernels *g_active = NULL;
+
+static int best_supported(void)
+{
+    int best = 0;
+    for (int k = 0; k < NUM_ISAS; ++k)
+        if (g_isas[k].supported())
+            best = k;
+    return best;
+}
+
+int cloth_kernels_select(const char *isa)
+{
+    int best = best_supported();
+    int pick = best, ok = 1;
+    const char *why = "auto";
+
+    if (isa && strcmp(isa, "auto") != 0)
+    {
+        int found = -1;
+        for (int k = 0; k < NUM_ISAS; ++k)
+            if (!strcmp(g_isas[k].name, isa))
+                found = k;
+        if (found < 0)
+        {
+            fprintf(stderr, "cpu: ISA desconocida '%s'\n", isa);
+            ok = 0;
+        }
+        else if (!g_isas[found].supported())
+        {
+            fprintf(stderr, "cpu: esta CPU no soporta '%s'\n", isa);
+            ok = 0;
+        }
+        else
+        {
+            pick = found;
+            why = "forzado";
+        }
+    }
+    g_active = g_isas[pick].table;
+
+    char avail[64] = "";
+    for (int k = 0; k < NUM_ISAS; ++k)
+    {
+        if (!g_isas[k].supported())
+            continue;
+        if (avail[0])
+            strncat(avail, " ", sizeof(avail) - strlen(avail) - 1);
+        strncat(avail, g_isas[k].name, sizeof(avail) - strlen(avail) - 1);
+    }
+    printf("cpu: kernels %s (%s; soportadas: %s)\n", g_active->name, why, avail);
+    return ok;
+}
+
+const ClothKernels *cloth_kernels(void)
+{
+    if (!g_active)
+        cloth_kernels_select("auto");
+    return g_active;
+}
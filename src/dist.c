@@ -0,0 +1,684 @@
+// fork/socketpair/mmap compartido necesitan las extensiones POSIX
+#define _GNU_SOURCE
+#include "dist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define DIST_POSIX 1
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Profundidad de un píxel que ningún fragmento cubrió
+#define DIST_NO_DEPTH -1e30f
+
+enum
+{
+    OP_SIM = 1,   // update de la franja + raster con (tx, ty)
+    OP_COMPOSITE, // componer la franja de filas propia de la imagen final
+    OP_QUIT
+};
+
+typedef struct
+{
+    int op;
+    float t;
+    float tx, ty;
+} DistCmd;
+
+typedef struct
+{
+    float minx, maxx, miny, maxy; // bbox de los puntos (sin paneo), para el centrado
+    double ms;
+    double bytes; // bytes leídos de framebuffers ajenos al componer
+} DistReply;
+
+// Rectángulo [x0, x1) x [y0, y1) que el trabajador pintó en su framebuffer
+typedef struct
+{
+    int x0, y0, x1, y1;
+} DistBox;
+
+struct DistCluster
+{
+    int M, W, H;
+    ClothParams P;
+    pid_t *pid;
+    int *fd; // extremo del coordinador de cada socketpair
+
+    unsigned char *shm;
+    size_t shm_bytes;
+    DistBox *box;          // M
+    unsigned char **color; // M framebuffers RGBA
+    float **depth;         // M buffers de profundidad
+    unsigned char *final;  // imagen compuesta RGBA
+
+    DistReply *rep; // respuestas del último ida y vuelta (M)
+    float tx, ty;   // centrado suavizado (misma EMA que cloth_update)
+    DistStats last, total;
+};
+
+#ifdef DIST_POSIX
+static int write_full(int fd, const void *buf, size_t n)
+{
+    const char *p = (const char *)buf;
+    while (n > 0)
+    {
+        ssize_t k = send(fd, p, n, MSG_NOSIGNAL);
+        if (k < 0 && errno == EINTR)
+            continue;
+        if (k <= 0)
+            return 0;
+        p += k;
+        n -= (size_t)k;
+    }
+    return 1;
+}
+
+static int read_full(int fd, void *buf, size_t n)
+{
+    char *p = (char *)buf;
+    while (n > 0)
+    {
+        ssize_t k = read(fd, p, n);
+        if (k < 0 && errno == EINTR)
+            continue;
+        if (k <= 0)
+            return 0;
+        p += k;
+        n -= (size_t)k;
+    }
+    return 1;
+}
+
+static void clear_box(DistCluster *D, int w)
+{
+    const DistBox b = D->box[w];
+    if (b.x1 <= b.x0 || b.y1 <= b.y0)
+        return;
+    const size_t W = (size_t)D->W;
+    for (int y = b.y0; y < b.y1; ++y)
+    {
+        memset(D->color[w] + ((size_t)y * W + (size_t)b.x0) * 4, 0, (size_t)(b.x1 - b.x0) * 4);
+        float *dr = D->depth[w] + (size_t)y * W;
+        for (int x = b.x0; x < b.x1; ++x)
+            dr[x] = DIST_NO_DEPTH;
+    }
+}
+
+// Capa de un píxel al componer: profundidad y trabajador dueño
+typedef struct
+{
+    float z;
+    int k;
+} DistLayer;
+
+// Reparto de esferas por tramo de filas en raster (solo en los trabajadores):
+// conteos nt x nt + offsets nt+1 y las listas por tramo, reusados entre frames
+static size_t *g_band_cnt = NULL;
+static size_t g_band_cnt_cap = 0;
+static int *g_band_list = NULL;
+static size_t g_band_list_cap = 0;
+
+// Tramos [i0, i1] de los 'nb' en que se parten las filas [y0b, y0b+rows) que
+// toca el disco de la esfera k; 0 si no toca ninguna. El tramo i empieza en
+// y0b + rows*i/nb, así que la fila y cae en floor(((y-y0b+1)*nb - 1)/rows).
+static int sphere_bands(const ClothState *S, int k, float ty, int y0b, int rows, int nb, int *i0, int *i1)
+{
+    const DrawItem *d = &S->draw[k];
+    const float cy = draw_dec_xy(d->y) + ty, r = draw_radius_lut[d->rcode];
+    long y0 = (long)floorf(cy - r) - y0b, y1 = (long)ceilf(cy + r) - y0b; // [y0, y1)
+    if (y0 < 0)
+        y0 = 0;
+    if (y1 > rows)
+        y1 = rows;
+    if (y1 <= y0)
+        return 0;
+    *i0 = (int)(((y0 + 1) * nb - 1) / rows);
+    *i1 = (int)((y1 * nb - 1) / rows);
+    return 1;
+}
+
+// Rasteriza la franja en orden de pintor: discos con el mismo perfil de alpha
+// que el sprite, mezcla "over" y profundidad del último fragmento dibujado
+// (el orden es por profundidad creciente, así que el último es el de encima).
+static void raster(DistCluster *D, int w, const ClothState *S, float tx, float ty)
+{
+    const int W = D->W, H = D->H;
+    const size_t N = S->N;
+    unsigned char *col = D->color[w];
+    float *dep = D->depth[w];
+
+    float fx0 = 1e30f, fy0 = 1e30f, fx1 = -1e30f, fy1 = -1e30f;
+    for (size_t k = 0; k < N; ++k)
+    {
+        const DrawItem *d = &S->draw[k];
+        const float x = draw_dec_xy(d->x), y = draw_dec_xy(d->y), r = draw_radius_lut[d->rcode];
+        fx0 = fminf(fx0, x - r);
+        fx1 = fmaxf(fx1, x + r);
+        fy0 = fminf(fy0, y - r);
+        fy1 = fmaxf(fy1, y + r);
+    }
+    DistBox b;
+    b.x0 = (int)fmaxf(floorf(fx0 + tx), 0.f);
+    b.y0 = (int)fmaxf(floorf(fy0 + ty), 0.f);
+    b.x1 = (int)fminf(ceilf(fx1 + tx) + 1.f, (float)W);
+    b.y1 = (int)fminf(ceilf(fy1 + ty) + 1.f, (float)H);
+    if (b.x1 <= b.x0 || b.y1 <= b.y0)
+        b.x0 = b.y0 = b.x1 = b.y1 = 0;
+    D->box[w] = b;
+
+    const int rows = b.y1 - b.y0;
+    if (rows <= 0)
+        return;
+
+    // Cada hilo pinta un tramo de filas: sin carreras y respetando el orden
+    // de pintor dentro de cada píxel. Para no recorrer las N esferas en cada
+    // hilo, primero se reparten una sola vez por tramo: cada hilo clasifica
+    // un pedazo de la lista de pintor (conteo, prefijo y llenado, como el
+    // bucket sort) y las listas quedan en orden de pintor.
+    int ok = 1;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+#ifdef _OPENMP
+        const int tid = omp_get_thread_num(), nt = omp_get_num_threads();
+#else
+        const int tid = 0, nt = 1;
+#endif
+        const size_t q0 = N * (size_t)tid / (size_t)nt, q1 = N * (size_t)(tid + 1) / (size_t)nt;
+#ifdef _OPENMP
+#pragma omp single
+#endif
+        {
+            const size_t need = (size_t)nt * (size_t)nt + (size_t)nt + 1;
+            if (need > g_band_cnt_cap)
+            {
+                size_t *nc = (size_t *)realloc(g_band_cnt, need * sizeof(size_t));
+                if (nc)
+                {
+                    g_band_cnt = nc;
+                    g_band_cnt_cap = need;
+                }
+                else
+                    ok = 0;
+            }
+        }
+        size_t *cnt = ok ? g_band_cnt + (size_t)tid * (size_t)nt : NULL;
+        size_t *off = ok ? g_band_cnt + (size_t)nt * (size_t)nt : NULL;
+        if (ok)
+        {
+            memset(cnt, 0, (size_t)nt * sizeof(size_t));
+            for (size_t q = q0; q < q1; ++q)
+            {
+                int i0, i1;
+                if (sphere_bands(S, S->order_idx[q], ty, b.y0, rows, nt, &i0, &i1))
+                    for (int i = i0; i <= i1; ++i)
+                        cnt[i]++;
+            }
+        }
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+        if (ok)
+        {
+            // Offsets tramo-mayor: la lista de cada tramo queda contigua y los
+            // pedazos de la lista de pintor, uno tras otro
+            size_t sum = 0;
+            for (int i = 0; i < nt; ++i)
+            {
+                off[i] = sum;
+                for (int c = 0; c < nt; ++c)
+                {
+                    size_t *pc = g_band_cnt + (size_t)c * (size_t)nt + (size_t)i;
+                    const size_t n = *pc;
+                    *pc = sum;
+                    sum += n;
+                }
+            }
+            off[nt] = sum;
+            if (sum > g_band_list_cap)
+            {
+                int *nl = (int *)realloc(g_band_list, sum * sizeof(int));
+                if (nl)
+                {
+                    g_band_list = nl;
+                    g_band_list_cap = sum;
+                }
+                else
+                    ok = 0;
+            }
+        }
+        if (ok)
+        {
+            for (size_t q = q0; q < q1; ++q)
+            {
+                int i0, i1;
+                if (sphere_bands(S, S->order_idx[q], ty, b.y0, rows, nt, &i0, &i1))
+                    for (int i = i0; i <= i1; ++i)
+                        g_band_list[cnt[i]++] = S->order_idx[q];
+            }
+        }
+#ifdef _OPENMP
+#pragma omp barrier
+#endif
+        const int ys = b.y0 + rows * tid / nt, ye = b.y0 + rows * (tid + 1) / nt;
+        const size_t l0 = ok ? off[tid] : 0, l1 = ok ? off[tid + 1] : 0;
+        for (size_t l = l0; l < l1; ++l)
+        {
+            const int k = g_band_list[l];
+            const DrawItem *d = &S->draw[k];
+            const float cx = draw_dec_xy(d->x) + tx, cy = draw_dec_xy(d->y) + ty;
+            const float r = draw_radius_lut[d->rcode];
+            int y0 = (int)floorf(cy - r), y1 = (int)ceilf(cy + r);
+            int x0 = (int)floorf(cx - r), x1 = (int)ceilf(cx + r);
+            if (y0 < ys)
+                y0 = ys;
+            if (y1 > ye)
+                y1 = ye;
+            if (x0 < 0)
+                x0 = 0;
+            if (x1 > W)
+                x1 = W;
+            const float invr2 = 1.0f / (r * r);
+            const float a8 = (float)d->a8 * (1.0f / 255.0f);
+            const float z = (float)S->depth[k];
+            unsigned char r8, g8, b8;
+            draw_dec_rgb(d->rgb565, &r8, &g8, &b8);
+            for (int y = y0; y < y1; ++y)
+            {
+                const float dy = (float)y + 0.5f - cy;
+                unsigned char *pc = col + (size_t)y * (size_t)W * 4;
+                float *pd = dep + (size_t)y * (size_t)W;
+                for (int x = x0; x < x1; ++x)
+                {
+                    const float dx = (float)x + 0.5f - cx;
+                    const float q2 = (dx * dx + dy * dy) * invr2;
+                    if (q2 >= 1.0f)
+                        continue;
+                    const float a = a8 * (1.0f - q2), ia = 1.0f - a;
+                    unsigned char *px = pc + 4 * x;
+                    px[0] = (unsigned char)((float)r8 * a + (float)px[0] * ia);
+                    px[1] = (unsigned char)((float)g8 * a + (float)px[1] * ia);
+                    px[2] = (unsigned char)((float)b8 * a + (float)px[2] * ia);
+                    px[3] = (unsigned char)(255.0f * a + (float)px[3] * ia);
+                    pd[x] = z;
+                }
+            }
+        }
+    }
+    if (!ok)
+        fprintf(stderr, "dist: trabajador %d sin memoria para repartir esferas por filas\n", w);
+}
+
+// Direct-send: el trabajador w compone las filas [H*w/M, H*(w+1)/M) leyendo
+// solo los rectángulos pintados de cada framebuffer. Cada framebuffer es RGBA
+// premultiplicado (la mezcla "over" sobre transparente lo deja así) y su
+// profundidad es la del fragmento de encima; por píxel se ordenan las capas
+// por esa profundidad y se componen de atrás hacia adelante con "over" sobre
+// el fondo negro, así una capa translúcida deja ver las de otros trabajadores.
+static double composite(DistCluster *D, int w, DistLayer *lay)
+{
+    const int W = D->W, M = D->M;
+    const int ys = D->H * w / M, ye = D->H * (w + 1) / M;
+    double bytes = 0.0;
+    for (int y = ys; y < ye; ++y)
+    {
+        unsigned char *out = D->final + (size_t)y * (size_t)W * 4;
+        for (int x = 0; x < W; ++x)
+        {
+            // Capas con fragmento en (x, y), insertadas por profundidad creciente
+            int n = 0;
+            for (int k = 0; k < M; ++k)
+            {
+                const DistBox b = D->box[k];
+                if (y < b.y0 || y >= b.y1 || x < b.x0 || x >= b.x1)
+                    continue;
+                const float z = D->depth[k][(size_t)y * (size_t)W + (size_t)x];
+                if (z == DIST_NO_DEPTH)
+                    continue;
+                int i = n++;
+                while (i > 0 && lay[i - 1].z > z)
+                {
+                    lay[i] = lay[i - 1];
+                    --i;
+                }
+                lay[i].z = z;
+                lay[i].k = k;
+            }
+            float r = 0.f, g = 0.f, bl = 0.f;
+            for (int i = 0; i < n; ++i)
+            {
+                const unsigned char *pc = D->color[lay[i].k] + ((size_t)y * (size_t)W + (size_t)x) * 4;
+                const float ia = 1.0f - (float)pc[3] * (1.0f / 255.0f);
+                r = (float)pc[0] + r * ia;
+                g = (float)pc[1] + g * ia;
+                bl = (float)pc[2] + bl * ia;
+            }
+            out[4 * x + 0] = (unsigned char)fminf(r + 0.5f, 255.f);
+            out[4 * x + 1] = (unsigned char)fminf(g + 0.5f, 255.f);
+            out[4 * x + 2] = (unsigned char)fminf(bl + 0.5f, 255.f);
+            out[4 * x + 3] = 255;
+        }
+        for (int k = 0; k < M; ++k)
+        {
+            const DistBox b = D->box[k];
+            if (k != w && y >= b.y0 && y < b.y1)
+                bytes += (double)(b.x1 - b.x0) * (4.0 + sizeof(float));
+        }
+    }
+    return bytes;
+}
+
+static void worker_main(DistCluster *D, int w, int fd, int threads)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#else
+    (void)threads;
+#endif
+    ClothParams P = D->P;
+    P.bandY0 = P.GY * w / D->M;
+    P.bandY1 = P.GY * (w + 1) / D->M;
+    P.autoCenter = 0; // el centrado es global: lo decide el coordinador
+    P.panX_px = P.panY_px = 0.f;
+    P.sortedDraw = 0; // raster recorre order_idx: tiene que escribirse siempre
+
+    // Renderer por software mínimo: cloth_init crea el sprite con él
+    SDL_Surface *surf = SDL_CreateRGBSurfaceWithFormat(0, 8, 8, 32, SDL_PIXELFORMAT_RGBA32);
+    SDL_Renderer *R = surf ? SDL_CreateSoftwareRenderer(surf) : NULL;
+    DistLayer *lay = (DistLayer *)malloc((size_t)D->M * sizeof(DistLayer));
+    ClothState S;
+    if (!R || !lay || cloth_init(R, &S, &P, D->W, D->H) != 0)
+    {
+        fprintf(stderr, "dist: trabajador %d no pudo inicializarse\n", w);
+        _exit(1);
+    }
+
+    DistCmd cmd;
+    while (read_full(fd, &cmd, sizeof(cmd)) && cmd.op != OP_QUIT)
+    {
+        DistReply rep;
+        memset(&rep, 0, sizeof(rep));
+        const Uint64 t0 = SDL_GetPerformanceCounter();
+        if (cmd.op == OP_SIM)
+        {
+            cloth_update(R, &S, D->W, D->H, cmd.t);
+            rep.minx = rep.miny = 1e30f;
+            rep.maxx = rep.maxy = -1e30f;
+            for (size_t k = 0; k < S.N; ++k)
+            {
+                const float x = draw_dec_xy(S.draw[k].x), y = draw_dec_xy(S.draw[k].y);
+                rep.minx = fminf(rep.minx, x);
+                rep.maxx = fmaxf(rep.maxx, x);
+                rep.miny = fminf(rep.miny, y);
+                rep.maxy = fmaxf(rep.maxy, y);
+            }
+            clear_box(D, w);
+            raster(D, w, &S, cmd.tx, cmd.ty);
+        }
+        else if (cmd.op == OP_COMPOSITE)
+        {
+            rep.bytes = composite(D, w, lay);
+        }
+        rep.ms = 1000.0 * (double)(SDL_GetPerformanceCounter() - t0) / (double)SDL_GetPerformanceFrequency();
+        if (!write_full(fd, &rep, sizeof(rep)))
+            break;
+    }
+    cloth_destroy(&S);
+    SDL_DestroyRenderer(R);
+    SDL_FreeSurface(surf);
+    free(lay);
+    free(g_band_cnt);
+    free(g_band_list);
+    _exit(0);
+}
+
+// Envía cmd a todos y junta las respuestas; 0 si algún trabajador no responde
+static int round_trip(DistCluster *D, const DistCmd *cmd, DistReply *rep)
+{
+    for (int w = 0; w < D->M; ++w)
+        if (!write_full(D->fd[w], cmd, sizeof(*cmd)))
+            return 0;
+    for (int w = 0; w < D->M; ++w)
+        if (!read_full(D->fd[w], &rep[w], sizeof(rep[w])))
+            return 0;
+    return 1;
+}
+#endif
+
+DistCluster *dist_start(int M, const ClothParams *CP, int W, int H, int threads_total)
+{
+#ifdef DIST_POSIX
+    if (M < 2 || CP->GY < M || W <= 0 || H <= 0)
+    {
+        fprintf(stderr, "dist: se necesitan 2 <= M <= filas de la malla (M=%d, GY=%d)\n", M, CP->GY);
+        return NULL;
+    }
+    DistCluster *D = (DistCluster *)calloc(1, sizeof(DistCluster));
+    if (!D)
+        return NULL;
+    D->M = M;
+    D->W = W;
+    D->H = H;
+    D->P = *CP;
+    D->pid = (pid_t *)calloc((size_t)M, sizeof(pid_t));
+    D->fd = (int *)malloc((size_t)M * sizeof(int));
+    D->color = (unsigned char **)calloc((size_t)M, sizeof(unsigned char *));
+    D->depth = (float **)calloc((size_t)M, sizeof(float *));
+    D->rep = (DistReply *)calloc((size_t)M, sizeof(DistReply));
+    if (!D->pid || !D->fd || !D->color || !D->depth || !D->rep)
+    {
+        dist_stop(D);
+        return NULL;
+    }
+
+    // Memoria compartida: cajas | M colores | M profundidades | imagen final
+    const size_t px = (size_t)W * (size_t)H;
+    const size_t box_bytes = ((size_t)M * sizeof(DistBox) + 63) & ~(size_t)63;
+    D->shm_bytes = box_bytes + (size_t)M * px * 4 + (size_t)M * px * sizeof(float) + px * 4;
+    void *mem = mmap(NULL, D->shm_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+    {
+        fprintf(stderr, "dist: mmap de %.1f MB falló\n", (double)D->shm_bytes / 1048576.0);
+        D->shm = NULL;
+        dist_stop(D);
+        return NULL;
+    }
+    D->shm = (unsigned char *)mem;
+    D->box = (DistBox *)D->shm;
+    unsigned char *p = D->shm + box_bytes;
+    for (int w = 0; w < M; ++w, p += px * 4)
+        D->color[w] = p;
+    for (int w = 0; w < M; ++w, p += px * sizeof(float))
+    {
+        D->depth[w] = (float *)p;
+        for (size_t k = 0; k < px; ++k)
+            D->depth[w][k] = DIST_NO_DEPTH;
+    }
+    D->final = p;
+
+    int (*sp)[2] = (int (*)[2])malloc((size_t)M * sizeof(*sp));
+    if (!sp)
+    {
+        dist_stop(D);
+        return NULL;
+    }
+    for (int w = 0; w < M; ++w)
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sp[w]) != 0)
+        {
+            fprintf(stderr, "dist: socketpair: %s\n", strerror(errno));
+            for (int k = 0; k < w; ++k)
+            {
+                close(sp[k][0]);
+                close(sp[k][1]);
+            }
+            free(sp);
+            dist_stop(D);
+            return NULL;
+        }
+
+    int per = threads_total / M;
+    if (per < 1)
+        per = 1;
+    fflush(NULL); // el hijo no debe repetir lo que quedó en los buffers de stdio
+    for (int w = 0; w < M; ++w)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            for (int k = 0; k < M; ++k)
+            {
+                close(sp[k][0]);
+                if (k != w)
+                    close(sp[k][1]);
+            }
+            worker_main(D, w, sp[w][1], per);
+        }
+        D->pid[w] = pid;
+        if (pid < 0)
+            fprintf(stderr, "dist: fork: %s\n", strerror(errno));
+    }
+    int ok = 1;
+    for (int w = 0; w < M; ++w)
+    {
+        close(sp[w][1]);
+        D->fd[w] = sp[w][0];
+        if (D->pid[w] <= 0)
+            ok = 0;
+    }
+    free(sp);
+    if (!ok)
+    {
+        dist_stop(D);
+        return NULL;
+    }
+    printf("dist: %d trabajadores x %d hilos, franjas de ~%d filas, framebuffer %dx%d (%.1f MB compartidos)\n",
+           M, per, CP->GY / M, W, H, (double)D->shm_bytes / 1048576.0);
+    return D;
+#else
+    (void)M;
+    (void)CP;
+    (void)W;
+    (void)H;
+    (void)threads_total;
+    fprintf(stderr, "dist: --dist requiere un sistema POSIX (fork/socketpair)\n");
+    return NULL;
+#endif
+}
+
+const void *dist_frame(DistCluster *D, float t)
+{
+#ifdef DIST_POSIX
+    const Uint64 t0 = SDL_GetPerformanceCounter();
+    const double freq = (double)SDL_GetPerformanceFrequency();
+    DistReply *rep = D->rep;
+    DistStats st;
+    memset(&st, 0, sizeof(st));
+
+    // Fase 1: cada trabajador simula y rasteriza su franja con el centrado
+    // acumulado hasta el frame anterior (la EMA del centrado hace invisible
+    // ese frame de retraso y ahorra un ida y vuelta).
+    DistCmd cmd = {OP_SIM, t, D->tx, D->ty};
+    if (!round_trip(D, &cmd, rep))
+        return NULL;
+    float minx = 1e30f, maxx = -1e30f, miny = 1e30f, maxy = -1e30f;
+    for (int w = 0; w < D->M; ++w)
+    {
+        minx = fminf(minx, rep[w].minx);
+        maxx = fmaxf(maxx, rep[w].maxx);
+        miny = fminf(miny, rep[w].miny);
+        maxy = fmaxf(maxy, rep[w].maxy);
+        st.sim_ms = fmax(st.sim_ms, rep[w].ms);
+    }
+    float tx_target = D->P.panX_px, ty_target = D->P.panY_px;
+    if (D->P.autoCenter)
+    {
+        tx_target += (float)D->W * 0.5f - 0.5f * (minx + maxx);
+        ty_target += (float)D->H * 0.5f - 0.5f * (miny + maxy);
+    }
+    D->tx += 0.2f * (tx_target - D->tx);
+    D->ty += 0.2f * (ty_target - D->ty);
+
+    // Fase 2: composición por franjas de filas de la imagen final
+    cmd.op = OP_COMPOSITE;
+    if (!round_trip(D, &cmd, rep))
+        return NULL;
+    for (int w = 0; w < D->M; ++w)
+    {
+        st.composite_ms = fmax(st.composite_ms, rep[w].ms);
+        st.comm_bytes += rep[w].bytes;
+    }
+    // Imagen final (cada trabajador escribe su franja) + mensajes de control
+    st.comm_bytes += (double)D->W * (double)D->H * 4.0;
+    st.comm_bytes += 2.0 * (double)D->M * (double)(sizeof(DistCmd) + sizeof(DistReply));
+    st.frame_ms = 1000.0 * (double)(SDL_GetPerformanceCounter() - t0) / freq;
+    st.frames = 1;
+
+    D->last = st;
+    D->total.sim_ms += st.sim_ms;
+    D->total.composite_ms += st.composite_ms;
+    D->total.frame_ms += st.frame_ms;
+    D->total.comm_bytes += st.comm_bytes;
+    D->total.frames++;
+    return D->final;
+#else
+    (void)D;
+    (void)t;
+    return NULL;
+#endif
+}
+
+void dist_stats(const DistCluster *D, DistStats *last, DistStats *total)
+{
+    if (last)
+        *last = D->last;
+    if (total)
+        *total = D->total;
+}
+
+void dist_stop(DistCluster *D)
+{
+    if (!D)
+        return;
+#ifdef DIST_POSIX
+    if (D->pid && D->fd)
+    {
+        DistCmd cmd = {OP_QUIT, 0.f, 0.f, 0.f};
+        for (int w = 0; w < D->M; ++w)
+            if (D->pid[w] > 0)
+            {
+                write_full(D->fd[w], &cmd, sizeof(cmd));
+                close(D->fd[w]);
+            }
+        for (int w = 0; w < D->M; ++w)
+            if (D->pid[w] > 0)
+                waitpid(D->pid[w], NULL, 0);
+    }
+    if (D->shm)
+        munmap(D->shm, D->shm_bytes);
+#endif
+    free(D->pid);
+    free(D->fd);
+    free(D->color);
+    free(D->depth);
+    free(D->rep);
+    free(D);
+}
@@ -0,0 +1,44 @@
+#ifndef DIST_H
+#define DIST_H
+
+#include <SDL2/SDL.h>
+#include "cloth.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Render distribuido sort-last en procesos locales (--dist M).
+    // La malla GX x GY se parte en M franjas de filas; cada proceso trabajador
+    // simula su franja y la rasteriza por software con profundidad en su propio
+    // framebuffer (memoria compartida). Luego cada trabajador compone una franja
+    // de filas de la imagen final leyendo los M framebuffers (direct-send) y
+    // el coordinador solo sube la imagen terminada. El control va por sockets
+    // Unix (socketpair), los píxeles por mmap compartido.
+    typedef struct DistCluster DistCluster;
+
+    typedef struct
+    {
+        double sim_ms;        // update + raster (máximo entre trabajadores)
+        double composite_ms;  // composición (máximo entre trabajadores)
+        double frame_ms;      // pared en el coordinador (ambas fases)
+        double comm_bytes;    // bytes leídos de framebuffers ajenos + imagen final + mensajes
+        long frames;
+    } DistStats;
+
+    // Debe llamarse antes de SDL_Init y de cualquier región OpenMP: hace fork.
+    // W x H es la resolución fija del framebuffer distribuido. threads_total se
+    // reparte entre los trabajadores. Devuelve NULL si no se pudo (con aviso).
+    DistCluster *dist_start(int M, const ClothParams *CP, int W, int H, int threads_total);
+    // Un frame completo en el instante t; devuelve la imagen RGBA32 (pitch W*4)
+    // o NULL si algún trabajador murió.
+    const void *dist_frame(DistCluster *D, float t);
+    // Estadísticas del último frame (last) y acumuladas (total)
+    void dist_stats(const DistCluster *D, DistStats *last, DistStats *total);
+    void dist_stop(DistCluster *D);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,295 @@
+// pread y las funciones de directorio necesitan las declaraciones POSIX
+#define _GNU_SOURCE
+#include "energy.h"
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#define ENERGY_MAX_DOM 8
+#define ENERGY_MAX_CFG 32
+
+typedef struct
+{
+    int fd;                   // abierto (sysfs) o -1 si se reabre en cada muestra
+    char path[256];
+    unsigned long long range; // max_energy_range_uj; 0 = desconocido (sin vuelta)
+    unsigned long long last;  // última lectura en µJ
+    char name[48];
+} EnergyDom;
+
+// Acumulado por configuración (backend + hilos)
+typedef struct
+{
+    char backend[16];
+    int threads;
+    double joules, seconds, spheres;
+    long frames;
+} EnergyAcc;
+
+static int g_enabled = 0;
+static EnergyDom g_dom[ENERGY_MAX_DOM];
+static int g_ndom = 0;
+static Uint64 g_last_t = 0;
+static EnergyAcc g_acc[ENERGY_MAX_CFG];
+static int g_nacc = 0;
+static long g_resets = 0; // lecturas que retrocedieron sin rango conocido
+
+#ifdef __linux__
+// sysfs permite releer el valor actual con pread en el offset 0
+static int read_u64(int fd, unsigned long long *v)
+{
+    char buf[32];
+    const ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0)
+        return 0;
+    buf[n] = '\0';
+    char *end = NULL;
+    *v = strtoull(buf, &end, 10);
+    return end != buf;
+}
+
+static int read_u64_path(const char *path, unsigned long long *v)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    const int ok = read_u64(fd, v);
+    close(fd);
+    return ok;
+}
+
+static int read_dom(const EnergyDom *D, unsigned long long *v)
+{
+    return D->fd >= 0 ? read_u64(D->fd, v) : read_u64_path(D->path, v);
+}
+
+// reopen = 1 para archivos comunes (contadores falsos): quien los escribe
+// puede reemplazarlos con rename y un descriptor abierto quedaría viejo
+static int add_domain(const char *energy, const char *range, const char *name, int reopen)
+{
+    if (g_ndom >= ENERGY_MAX_DOM)
+        return 0;
+    EnergyDom *D = &g_dom[g_ndom];
+    snprintf(D->path, sizeof(D->path), "%s", energy);
+    D->fd = open(energy, O_RDONLY);
+    if (D->fd < 0 || !read_u64(D->fd, &D->last))
+    {
+        fprintf(stderr, "energy: no se pudo leer %s (%s)%s\n", energy, strerror(errno),
+                errno == EACCES ? "; energy_uj suele requerir root" : "");
+        if (D->fd >= 0)
+            close(D->fd);
+        return 0;
+    }
+    if (reopen)
+    {
+        close(D->fd);
+        D->fd = -1;
+    }
+    D->range = 0;
+    if (range && !read_u64_path(range, &D->range))
+        D->range = 0;
+    snprintf(D->name, sizeof(D->name), "%s", name);
+    g_ndom++;
+    return 1;
+}
+
+// Zona powercap: energy_uj, max_energy_range_uj y name (p. ej. package-0)
+static int add_zone(const char *dir)
+{
+    char energy[512], range[512], namef[512], name[48];
+    snprintf(energy, sizeof(energy), "%s/energy_uj", dir);
+    snprintf(range, sizeof(range), "%s/max_energy_range_uj", dir);
+    snprintf(namef, sizeof(namef), "%s/name", dir);
+    snprintf(name, sizeof(name), "%s", dir);
+    FILE *fp = fopen(namef, "r");
+    if (fp)
+    {
+        if (fgets(name, sizeof(name), fp))
+            name[strcspn(name, "\n")] = '\0';
+        fclose(fp);
+    }
+    return add_domain(energy, range, name, 0);
+}
+
+// Solo las zonas de primer nivel (intel-rapl:N): las subzonas (core, uncore,
+// dram) ya están incluidas en el paquete y se contarían dos veces
+static void scan_powercap(void)
+{
+    const char *root = "/sys/class/powercap";
+    DIR *d = opendir(root);
+    if (!d)
+        return;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL)
+    {
+        const char *c = strchr(e->d_name, ':');
+        if (strncmp(e->d_name, "intel-rapl:", 11) != 0 || strchr(c + 1, ':'))
+            continue;
+        char dir[512];
+        snprintf(dir, sizeof(dir), "%s/%s", root, e->d_name);
+        add_zone(dir);
+    }
+    closedir(d);
+}
+
+// Julios desde la muestra anterior, sumados sobre los dominios
+static double sample_joules(void)
+{
+    double uj = 0.0;
+    for (int k = 0; k < g_ndom; ++k)
+    {
+        EnergyDom *D = &g_dom[k];
+        unsigned long long v;
+        if (!read_dom(D, &v))
+            continue;
+        if (v >= D->last)
+            uj += (double)(v - D->last);
+        else if (D->range > 0)
+            uj += (double)(D->range - D->last + v); // vuelta del contador
+        else
+            g_resets++;
+        D->last = v;
+    }
+    return uj * 1e-6;
+}
+#endif
+
+int energy_open(const char *path)
+{
+#ifdef __linux__
+    g_ndom = 0;
+    if (!path)
+        scan_powercap();
+    else
+    {
+        struct stat st;
+        if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+            add_zone(path);
+        else
+            add_domain(path, NULL, path, 1);
+    }
+    if (g_ndom == 0)
+    {
+        fprintf(stderr, "energy: sin contadores RAPL legibles%s; --energy desactivado\n",
+                path ? "" : " en /sys/class/powercap");
+        return 0;
+    }
+    memset(g_acc, 0, sizeof(g_acc));
+    g_nacc = 0;
+    g_resets = 0;
+    g_enabled = 1;
+    g_last_t = SDL_GetPerformanceCounter();
+    printf("energy: %d dominio(s):", g_ndom);
+    for (int k = 0; k < g_ndom; ++k)
+        printf(" %s", g_dom[k].name);
+    printf("\n");
+    return g_ndom;
+#else
+    (void)path;
+    fprintf(stderr, "energy: --energy solo está disponible en Linux\n");
+    return 0;
+#endif
+}
+
+int energy_enabled(void) { return g_enabled; }
+
+void energy_frame(const char *backend, int threads, size_t spheres)
+{
+    if (!g_enabled)
+        return;
+#ifdef __linux__
+    const Uint64 t1 = SDL_GetPerformanceCounter();
+    const double J = sample_joules();
+    const double dt = (double)(t1 - g_last_t) / (double)SDL_GetPerformanceFrequency();
+    g_last_t = t1;
+
+    EnergyAcc *A = NULL;
+    for (int k = 0; k < g_nacc && !A; ++k)
+        if (g_acc[k].threads == threads && !strcmp(g_acc[k].backend, backend))
+            A = &g_acc[k];
+    if (!A)
+    {
+        // Tabla llena: el resto de configuraciones se agrupa en la última
+        A = &g_acc[g_nacc < ENERGY_MAX_CFG ? g_nacc++ : ENERGY_MAX_CFG - 1];
+        if (A->frames == 0)
+        {
+            snprintf(A->backend, sizeof(A->backend), "%s", backend);
+            A->threads = threads;
+        }
+        else
+        {
+            snprintf(A->backend, sizeof(A->backend), "otros");
+            A->threads = 0;
+        }
+    }
+    A->joules += J;
+    A->seconds += dt;
+    A->spheres += (double)spheres;
+    A->frames++;
+#else
+    (void)backend;
+    (void)threads;
+    (void)spheres;
+#endif
+}
+
+void energy_resync(void)
+{
+    if (!g_enabled)
+        return;
+#ifdef __linux__
+    sample_joules();
+    g_last_t = SDL_GetPerformanceCounter();
+#endif
+}
+
+void energy_report(FILE *fp)
+{
+    if (!g_enabled)
+        return;
+    // La configuración más eficiente por esfera se marca con '*'
+    int best = -1;
+    for (int k = 0; k < g_nacc; ++k)
+        if (g_acc[k].frames > 0 && g_acc[k].spheres > 0.0 &&
+            (best < 0 || g_acc[k].joules / g_acc[k].spheres < g_acc[best].joules / g_acc[best].spheres))
+            best = k;
+    fprintf(fp, "energy: %-10s %3s %7s %9s %8s %9s %9s\n", "backend", "T", "frames", "ms/frame", "W",
+            "mJ/frame", "nJ/esf");
+    double J = 0.0, s = 0.0;
+    long frames = 0;
+    for (int k = 0; k < g_nacc; ++k)
+    {
+        const EnergyAcc *A = &g_acc[k];
+        if (A->frames == 0)
+            continue;
+        const double nf = (double)A->frames;
+        fprintf(fp, "energy: %-10s %3d %7ld %9.3f %8.2f %9.3f %9.3f%s\n", A->backend, A->threads, A->frames,
+                1000.0 * A->seconds / nf, A->seconds > 0.0 ? A->joules / A->seconds : 0.0, 1000.0 * A->joules / nf,
+                A->spheres > 0.0 ? 1e9 * A->joules / A->spheres : 0.0, k == best && g_nacc > 1 ? " *" : "");
+        J += A->joules;
+        s += A->seconds;
+        frames += A->frames;
+    }
+    fprintf(fp, "energy: total %.2f J en %.1f s (%ld frames)\n", J, s, frames);
+    if (g_resets > 0)
+        fprintf(fp, "energy: %ld lecturas retrocedieron sin max_energy_range_uj (ignoradas)\n", g_resets);
+}
+
+void energy_close(void)
+{
+#ifdef __linux__
+    for (int k = 0; k < g_ndom; ++k)
+        if (g_dom[k].fd >= 0)
+            close(g_dom[k].fd);
+#endif
+    g_ndom = 0;
+    g_enabled = 0;
+}
@@ -0,0 +1,36 @@
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Energía por frame con los contadores RAPL de powercap (--energy). Se lee
+    // energy_uj de cada paquete (/sys/class/powercap/intel-rapl:N) al cerrar
+    // cada frame y la diferencia se atribuye a la configuración activa
+    // (backend + hilos), con corrección de la vuelta del contador según
+    // max_energy_range_uj. Fuera de Linux todo queda como no-op.
+
+    // path: NULL = autodetección; un directorio de zona powercap (con
+    // energy_uj) o directamente un archivo con un contador en µJ (p. ej. uno
+    // falso para pruebas). Devuelve cuántos dominios se abrieron (0 =
+    // desactivado, ya con aviso impreso).
+    int energy_open(const char *path);
+    int energy_enabled(void);
+    // Cierra el frame: la energía desde la muestra anterior va a 'backend'
+    // con 'threads' hilos, que dibujó 'spheres' esferas
+    void energy_frame(const char *backend, int threads, size_t spheres);
+    // Descarta lo consumido desde la última muestra (p. ej. con la ventana oculta)
+    void energy_resync(void);
+    // Por configuración: frames, ms/frame, W medios, mJ/frame y nJ/esfera
+    void energy_report(FILE *fp);
+    void energy_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,397 @@
+// mmap necesita las extensiones POSIX
+#define _GNU_SOURCE
+#include "geocap.h"
+#include "bufring.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdalign.h>
+#include <math.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GEO_POSIX 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define GEO_MAGIC "CLGEO3\0"
+#define GEO_ORDERED 1u // flags: registros en orden de dibujo, sin order_idx
+
+typedef struct
+{
+    char magic[8];
+    uint32_t flags;
+    int32_t GX, GY;
+    float baseRadius;
+    uint64_t cap;    // máximo de esferas por frame
+    uint64_t frames; // se completa al cerrar
+    uint64_t pad[3];
+} GeoFileHdr;
+
+typedef struct
+{
+    uint64_t bytes; // datos que siguen (con relleno a 8)
+    uint32_t n;
+    int32_t W, H;
+    float tx, ty;
+    uint32_t pad;
+} GeoFrameHdr;
+_Static_assert(sizeof(GeoFrameHdr) % 8 == 0, "los registros deben quedar alineados a 8");
+
+// Slot del anillo: copia cruda del frame (el reordenado es del escritor)
+typedef struct
+{
+    int n, W, H;
+    float tx, ty;
+} GeoSlot;
+// Los DrawItem del slot empiezan tras la cabecera, alineados a su tipo
+#define GEO_SLOT_HDR ((sizeof(GeoSlot) + alignof(DrawItem) - 1) / alignof(DrawItem) * alignof(DrawItem))
+
+struct GeoCapture
+{
+    FILE *fp;
+    int ordered;
+    size_t cap;
+    BufRing ring;
+    DrawItem *q; // frame en orden de dibujo (solo el escritor)
+    SDL_Thread *thr;
+    SDL_sem *sem;
+    atomic_int quit;
+    atomic_int io_error;
+    atomic_ullong written;
+    unsigned long long bytes; // escritos (solo el escritor; se lee tras el join)
+    unsigned long long submitted, dropped;
+    GeoFileHdr hdr;
+};
+
+struct GeoReplay
+{
+    unsigned char *map;
+    size_t bytes;
+    int mapped;
+    GeoFileHdr hdr;
+    size_t *off; // inicio de cada registro
+    long frames;
+    int *ident; // order_idx identidad para los frames en orden de dibujo
+};
+
+static size_t pad8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+static int write_frame(GeoCapture *G, const unsigned char *slot)
+{
+    const GeoSlot *s = (const GeoSlot *)slot;
+    const DrawItem *draw = (const DrawItem *)(slot + GEO_SLOT_HDR);
+    const int *order = (const int *)(draw + G->cap);
+    const size_t n = (size_t)s->n;
+    static const unsigned char zero[8] = {0};
+    GeoFrameHdr fh = {0, (uint32_t)n, s->W, s->H, s->tx, s->ty, 0};
+    size_t data;
+    if (G->ordered)
+    {
+        // En orden de dibujo: la reproducción no necesita order_idx
+        for (size_t q = 0; q < n; ++q)
+            G->q[q] = draw[order[q]];
+        data = n * sizeof(DrawItem);
+    }
+    else
+        data = n * (sizeof(DrawItem) + sizeof(int));
+    fh.bytes = (uint64_t)pad8(data);
+    int ok = fwrite(&fh, sizeof(fh), 1, G->fp) == 1;
+    if (G->ordered)
+        ok = ok && fwrite(G->q, sizeof(DrawItem), n, G->fp) == n;
+    else
+        ok = ok && fwrite(draw, sizeof(DrawItem), n, G->fp) == n && fwrite(order, sizeof(int), n, G->fp) == n;
+    const size_t tail = (size_t)fh.bytes - data;
+    ok = ok && fwrite(zero, 1, tail, G->fp) == tail;
+    G->bytes += sizeof(fh) + fh.bytes;
+    return ok;
+}
+
+// Hilo escritor: reordena y escribe; es el único que hace I/O
+static int geo_writer_main(void *arg)
+{
+    GeoCapture *G = (GeoCapture *)arg;
+    trace_thread_name("geo-writer");
+    for (;;)
+    {
+        unsigned char *slot = bufring_peek(&G->ring);
+        if (!slot)
+        {
+            if (atomic_load(&G->quit))
+                break;
+            SDL_SemWaitTimeout(G->sem, 50);
+            continue;
+        }
+        TraceSpan sp = trace_begin("geo-write");
+        if (!write_frame(G, slot))
+            atomic_store(&G->io_error, 1);
+        bufring_release(&G->ring);
+        atomic_fetch_add(&G->written, 1ull);
+        trace_end(sp);
+    }
+    return 0;
+}
+
+GeoCapture *geocap_open(const char *path, const ClothState *S, int ordered, int slots)
+{
+    if (!path || S->N == 0)
+        return NULL;
+    GeoCapture *G = (GeoCapture *)calloc(1, sizeof(GeoCapture));
+    if (!G)
+        return NULL;
+    G->ordered = ordered;
+    G->cap = S->N;
+    if (slots < 2)
+        slots = 2;
+    G->fp = fopen(path, "wb");
+    if (!G->fp)
+    {
+        fprintf(stderr, "geocap: no se pudo abrir %s\n", path);
+        free(G);
+        return NULL;
+    }
+    memcpy(G->hdr.magic, GEO_MAGIC, sizeof(G->hdr.magic));
+    G->hdr.flags = ordered ? GEO_ORDERED : 0u;
+    G->hdr.GX = S->P.GX;
+    G->hdr.GY = S->P.GY;
+    G->hdr.baseRadius = S->P.baseRadius;
+    G->hdr.cap = (uint64_t)G->cap;
+    const size_t slot_bytes = GEO_SLOT_HDR + G->cap * (sizeof(DrawItem) + sizeof(int));
+    if (fwrite(&G->hdr, sizeof(G->hdr), 1, G->fp) != 1 || !bufring_init(&G->ring, (unsigned)slots, slot_bytes))
+        goto fail;
+    if (ordered && !(G->q = (DrawItem *)malloc(G->cap * sizeof(DrawItem))))
+        goto fail;
+    atomic_init(&G->quit, 0);
+    atomic_init(&G->io_error, 0);
+    atomic_init(&G->written, 0ull);
+    G->sem = SDL_CreateSemaphore(0);
+    if (!G->sem)
+        goto fail;
+    G->thr = SDL_CreateThread(geo_writer_main, "geo-writer", G);
+    if (!G->thr)
+        goto fail;
+    printf("geocap: %s, %zu esferas/frame (%s, %d buffers)\n", path, G->cap,
+           ordered ? "ordenada 8 B/esfera" : "cruda 12 B/esfera", slots);
+    return G;
+
+fail:
+    fprintf(stderr, "geocap: sin memoria o sin espacio para %s\n", path);
+    if (G->sem)
+        SDL_DestroySemaphore(G->sem);
+    bufring_free(&G->ring);
+    free(G->q);
+    fclose(G->fp);
+    free(G);
+    return NULL;
+}
+
+int geocap_push(GeoCapture *G, const ClothState *S, int W, int H)
+{
+    if (!G)
+        return 0;
+    unsigned char *slot = (S->N <= G->cap) ? bufring_acquire(&G->ring) : NULL;
+    if (!slot)
+    {
+        G->dropped++;
+        return 0;
+    }
+    GeoSlot *s = (GeoSlot *)slot;
+    s->n = (int)S->N;
+    s->W = W;
+    s->H = H;
+    s->tx = S->tx;
+    s->ty = S->ty;
+    DrawItem *draw = (DrawItem *)(slot + GEO_SLOT_HDR);
+    memcpy(draw, S->draw, S->N * sizeof(DrawItem));
+    memcpy(draw + G->cap, S->order_idx, S->N * sizeof(int));
+    bufring_publish(&G->ring);
+    G->submitted++;
+    SDL_SemPost(G->sem);
+    return 1;
+}
+
+void geocap_close(GeoCapture *G)
+{
+    if (!G)
+        return;
+    atomic_store(&G->quit, 1);
+    SDL_SemPost(G->sem);
+    SDL_WaitThread(G->thr, NULL);
+
+    const unsigned long long written = atomic_load(&G->written);
+    G->hdr.frames = written;
+    if (fseek(G->fp, 0, SEEK_SET) != 0 || fwrite(&G->hdr, sizeof(G->hdr), 1, G->fp) != 1)
+        atomic_store(&G->io_error, 1);
+    printf("geocap: %llu frames, %llu descartados, %.1f MB (%.2f B/esfera)%s\n", written, G->dropped,
+           (double)G->bytes / 1048576.0,
+           written ? (double)G->bytes / ((double)written * (double)G->cap) : 0.0,
+           atomic_load(&G->io_error) ? " (ERROR de escritura)" : "");
+    fclose(G->fp);
+    SDL_DestroySemaphore(G->sem);
+    bufring_free(&G->ring);
+    free(G->q);
+    free(G);
+}
+
+// Posición del registro que sigue al que empieza en pos, o 0 si ese registro
+// está incompleto o es inválido (captura cortada)
+static size_t next_record(const GeoReplay *P, size_t pos, int ordered)
+{
+    if (pos + sizeof(GeoFrameHdr) > P->bytes)
+        return 0;
+    const GeoFrameHdr *fh = (const GeoFrameHdr *)(P->map + pos);
+    const size_t need = (size_t)fh->n * (sizeof(DrawItem) + (ordered ? 0 : sizeof(int)));
+    const size_t avail = P->bytes - pos - sizeof(GeoFrameHdr);
+    if (fh->n > P->hdr.cap || fh->bytes < need || fh->bytes > avail || (fh->bytes & 7u) != 0)
+        return 0;
+    return pos + sizeof(GeoFrameHdr) + (size_t)fh->bytes;
+}
+
+GeoReplay *georeplay_open(const char *path)
+{
+    GeoReplay *P = (GeoReplay *)calloc(1, sizeof(GeoReplay));
+    if (!P)
+        return NULL;
+#ifdef GEO_POSIX
+    int fd = open(path, O_RDONLY);
+    struct stat sb;
+    if (fd >= 0 && fstat(fd, &sb) == 0 && (size_t)sb.st_size >= sizeof(GeoFileHdr))
+    {
+        void *mem = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mem != MAP_FAILED)
+        {
+            P->map = (unsigned char *)mem;
+            P->bytes = (size_t)sb.st_size;
+            P->mapped = 1;
+            madvise(mem, P->bytes, MADV_WILLNEED);
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+#else
+    // Sin mmap: el archivo completo a memoria
+    FILE *fp = fopen(path, "rb");
+    if (fp && fseek(fp, 0, SEEK_END) == 0)
+    {
+        long sz = ftell(fp);
+        rewind(fp);
+        if (sz >= (long)sizeof(GeoFileHdr) && (P->map = (unsigned char *)malloc((size_t)sz)))
+        {
+            P->bytes = (size_t)sz;
+            if (fread(P->map, 1, P->bytes, fp) != P->bytes)
+            {
+                free(P->map);
+                P->map = NULL;
+            }
+        }
+    }
+    if (fp)
+        fclose(fp);
+#endif
+    if (!P->map)
+    {
+        fprintf(stderr, "georeplay: no se pudo leer %s\n", path);
+        free(P);
+        return NULL;
+    }
+    memcpy(&P->hdr, P->map, sizeof(P->hdr));
+    if (memcmp(P->hdr.magic, GEO_MAGIC, sizeof(P->hdr.magic)) != 0 || P->hdr.cap == 0)
+    {
+        fprintf(stderr, "georeplay: %s no es una captura valida\n", path);
+        georeplay_close(P);
+        return NULL;
+    }
+
+    // Índice de registros; se valida cada uno contra el tamaño del archivo.
+    // frames = 0: la captura no se cerró; se recorren los registros hasta el
+    // último completo para saber cuántos hay.
+    const int ordered = (P->hdr.flags & GEO_ORDERED) != 0;
+    if (P->hdr.frames == 0)
+        for (size_t pos = sizeof(GeoFileHdr); (pos = next_record(P, pos, ordered)) != 0;)
+            P->hdr.frames++;
+    P->off = (size_t *)malloc((size_t)(P->hdr.frames ? P->hdr.frames : 1) * sizeof(size_t));
+    P->ident = ordered ? (int *)malloc((size_t)P->hdr.cap * sizeof(int)) : NULL;
+    if (!P->off || (ordered && !P->ident))
+    {
+        georeplay_close(P);
+        return NULL;
+    }
+    if (ordered)
+        for (size_t k = 0; k < (size_t)P->hdr.cap; ++k)
+            P->ident[k] = (int)k;
+    size_t pos = sizeof(GeoFileHdr);
+    while ((unsigned long long)P->frames < P->hdr.frames)
+    {
+        const size_t next = next_record(P, pos, ordered);
+        if (!next)
+            break;
+        P->off[P->frames++] = pos;
+        pos = next;
+    }
+    if (P->frames == 0)
+    {
+        fprintf(stderr, "georeplay: %s no tiene frames legibles\n", path);
+        georeplay_close(P);
+        return NULL;
+    }
+    printf("georeplay: %s, %ld frames x %llu esferas (%s, %s)\n", path, P->frames,
+           (unsigned long long)P->hdr.cap, ordered ? "ordenada" : "cruda", P->mapped ? "mmap" : "en memoria");
+    return P;
+}
+
+void georeplay_params(const GeoReplay *P, ClothParams *CP)
+{
+    CP->GX = P->hdr.GX;
+    CP->GY = P->hdr.GY;
+    CP->baseRadius = P->hdr.baseRadius;
+}
+
+long georeplay_frames(const GeoReplay *P)
+{
+    return P->frames;
+}
+
+int georeplay_view(GeoReplay *P, long k, const ClothState *base, ClothState *view, int *W, int *H)
+{
+    const unsigned char *rec = P->map + P->off[k % P->frames];
+    const GeoFrameHdr *fh = (const GeoFrameHdr *)rec;
+    const size_t n = fh->n;
+    *view = *base;
+    view->sorted = NULL;
+    view->bin_start = NULL;
+    view->depth = NULL; // la captura no guarda profundidad
+    view->N = n;
+    view->tx = fh->tx;
+    view->ty = fh->ty;
+    // Sin copia: los punteros apuntan al mapeo (registros alineados a 8)
+    view->draw = (DrawItem *)(rec + sizeof(GeoFrameHdr));
+    view->order_idx = P->ident ? P->ident : (int *)(view->draw + n);
+    view->order_cap = n;
+    *W = fh->W;
+    *H = fh->H;
+    return 1;
+}
+
+void georeplay_close(GeoReplay *P)
+{
+    if (!P)
+        return;
+#ifdef GEO_POSIX
+    if (P->mapped)
+        munmap(P->map, P->bytes);
+    else
+        free(P->map);
+#else
+    free(P->map);
+#endif
+    free(P->off);
+    free(P->ident);
+    free(P);
+}
@@ -0,0 +1,43 @@
+#ifndef GEOCAP_H
+#define GEOCAP_H
+
+#include <SDL2/SDL.h>
+#include "cloth.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Captura binaria de la geometría de cada frame (--geocap) y reproducción
+    // por mmap sin simular (--replay). Formato: cabecera GeoFileHdr y luego un
+    // registro por frame (GeoFrameHdr + datos, alineado a 8 bytes), en el
+    // orden de bytes nativo. Dos codificaciones:
+    //  - cruda: DrawItem[n] + order_idx[n] (12 B/esfera);
+    //  - ordenada (--geocap-ordered): DrawItem[n] ya en orden de dibujo
+    //    (8 B/esfera). No cuantiza más: DrawItem ya es compacto (ver sim.h).
+    // Ambas se reproducen sin copia desde el mapeo.
+    // La codificación y la escritura ocurren en un hilo propio: el hilo de
+    // render solo copia el frame a un slot libre del anillo (nunca bloquea).
+    typedef struct GeoCapture GeoCapture;
+    typedef struct GeoReplay GeoReplay;
+
+    // S ya inicializado: fija la capacidad por frame (S->N) y la malla
+    GeoCapture *geocap_open(const char *path, const ClothState *S, int ordered, int slots);
+    // Encola el frame (W x H = espacio de píxeles). Devuelve 0 si se descartó.
+    int geocap_push(GeoCapture *G, const ClothState *S, int W, int H);
+    // Drena la cola, completa la cabecera e imprime estadísticas
+    void geocap_close(GeoCapture *G);
+
+    GeoReplay *georeplay_open(const char *path);
+    // Malla y radio base de la captura (para inicializar el estado local)
+    void georeplay_params(const GeoReplay *P, ClothParams *CP);
+    long georeplay_frames(const GeoReplay *P);
+    // Arma en *view (copia de base) el frame k módulo el total, en bucle
+    int georeplay_view(GeoReplay *P, long k, const ClothState *base, ClothState *view, int *W, int *H);
+    void georeplay_close(GeoReplay *P);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
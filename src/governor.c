@@ -0,0 +1,125 @@
+#include "governor.h"
+#include <stdio.h>
+#include <string.h>
+
+#define GOV_WINDOW_S 0.5  // ventana de medición
+#define GOV_LOW 0.6       // holgura: media < 0.6 x objetivo
+#define GOV_CALM 3        // ventanas holgadas seguidas para subir
+#define GOV_HOLD_S 2.0    // espera mínima tras bajar
+#define GOV_HOLD_MAX_S 60.0
+
+// Niveles de calidad de mayor a menor. Primero se achica el radio (menos
+// relleno), luego la malla, y en los niveles bajos también la tasa de
+// simulación (el render interpola entre estados).
+static const struct
+{
+    float grid, radius;
+    double simhz;
+} k_levels[GOV_LEVELS] = {
+    {1.00f, 1.00f, 0.0},
+    {1.00f, 0.85f, 0.0},
+    {0.85f, 0.85f, 0.0},
+    {0.70f, 0.85f, 30.0},
+    {0.55f, 0.80f, 30.0},
+    {0.40f, 0.75f, 20.0},
+};
+
+void gov_init(Governor *G, double target_ms, int max_threads, double user_simhz)
+{
+    memset(G, 0, sizeof(*G));
+    G->target_ms = target_ms;
+    G->max_threads = max_threads > 0 ? max_threads : 1;
+    G->threads = G->max_threads;
+    G->user_simhz = user_simhz;
+    G->freq = SDL_GetPerformanceFrequency();
+    G->win_start = SDL_GetPerformanceCounter();
+    G->hold_s = GOV_HOLD_S;
+}
+
+int gov_frame(Governor *G, double work_ms)
+{
+    G->frames_at[G->level]++;
+    if (G->settle > 0)
+    {
+        G->settle--;
+        G->win_start = SDL_GetPerformanceCounter();
+        return 0;
+    }
+    G->win_sum += work_ms;
+    G->win_n++;
+    const Uint64 now = SDL_GetPerformanceCounter();
+    if ((double)(now - G->win_start) < GOV_WINDOW_S * (double)G->freq)
+        return 0;
+
+    const double mean = G->win_sum / (double)G->win_n;
+    G->last_ms = mean;
+    G->win_sum = 0.0;
+    G->win_n = 0;
+    G->win_start = now;
+
+    const int level0 = G->level, threads0 = G->threads;
+    if (mean > G->target_ms)
+    {
+        // Sobre el presupuesto: primero recuperar todos los hilos, luego bajar
+        // calidad. Si se acaba de subir, esa subida no se sostiene: se
+        // duplica la espera antes de volver a intentarlo.
+        G->calm_windows = 0;
+        if (G->last_up && (double)(now - G->last_up) < 2.0 * GOV_WINDOW_S * (double)G->freq * GOV_CALM)
+            G->hold_s = (G->hold_s * 2.0 < GOV_HOLD_MAX_S) ? G->hold_s * 2.0 : GOV_HOLD_MAX_S;
+        G->last_up = 0;
+        if (G->threads < G->max_threads)
+            G->threads = G->max_threads;
+        else if (G->level < GOV_LEVELS - 1)
+            G->level++;
+        G->hold_until = now + (Uint64)(G->hold_s * (double)G->freq);
+    }
+    else if (mean < GOV_LOW * G->target_ms)
+    {
+        // Holgura sostenida: subir calidad; ya en el máximo, liberar hilos
+        if (++G->calm_windows >= GOV_CALM && now >= G->hold_until)
+        {
+            G->calm_windows = 0;
+            if (G->level > 0)
+                G->level--;
+            else if (G->threads > 1)
+                G->threads--;
+            G->last_up = now;
+        }
+    }
+    else
+    {
+        // Banda muerta entre ambos umbrales: se queda como está
+        G->calm_windows = 0;
+        if (G->last_up && (double)(now - G->last_up) > GOV_HOLD_MAX_S * (double)G->freq)
+            G->hold_s = GOV_HOLD_S; // estable hace rato: se olvida la oscilación
+    }
+
+    if (G->level == level0 && G->threads == threads0)
+        return 0;
+    G->changes++;
+    G->settle = 2;
+    return 1;
+}
+
+void gov_settings(const Governor *G, GovSettings *out)
+{
+    const int L = G->level;
+    out->grid_scale = k_levels[L].grid;
+    out->radius_scale = k_levels[L].radius / k_levels[L].grid;
+    out->simhz = k_levels[L].simhz;
+    if (G->user_simhz > 0.0 && (out->simhz <= 0.0 || G->user_simhz < out->simhz))
+        out->simhz = G->user_simhz;
+    out->threads = G->threads;
+}
+
+void gov_print_summary(const Governor *G)
+{
+    long total = 0;
+    for (int L = 0; L < GOV_LEVELS; ++L)
+        total += G->frames_at[L];
+    printf("governor: objetivo %.2f ms | nivel final Q%d, %d hilos | %ld cambios | frames por nivel:",
+           G->target_ms, G->level, G->threads, G->changes);
+    for (int L = 0; L < GOV_LEVELS; ++L)
+        printf(" Q%d=%.0f%%", L, total ? 100.0 * (double)G->frames_at[L] / (double)total : 0.0);
+    printf("\n");
+}
@@ -0,0 +1,56 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <SDL2/SDL.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define GOV_LEVELS 6
+
+    // Gobernador de calidad (--target-ms): mide el trabajo por frame
+    // (inicio → antes de esperar al pacer) en ventanas de ~0.5 s y mueve un
+    // nivel de calidad (densidad de malla, radio, tasa de simulación) y el
+    // número de hilos para quedar bajo el presupuesto. Histéresis: baja
+    // calidad con una ventana sobre el objetivo, sube solo tras varias
+    // ventanas holgadas y nunca poco después de haber bajado.
+    typedef struct
+    {
+        float grid_scale;   // fracción de GX y GY
+        float radius_scale; // factor sobre el radio base (ya compensa la malla más rala)
+        double simhz;       // 0 = simular cada frame
+        int threads;        // hilos OpenMP a usar
+    } GovSettings;
+
+    typedef struct
+    {
+        double target_ms;
+        int level;                // 0 = calidad máxima
+        int threads, max_threads; // hilos en uso / disponibles
+        double user_simhz;        // --simhz pedido (tope para los niveles)
+
+        Uint64 freq, win_start;
+        double win_sum;
+        int win_n;
+        int calm_windows;  // ventanas seguidas bajo el umbral inferior
+        Uint64 hold_until; // sin subir calidad hasta este instante
+        Uint64 last_up;    // última subida (para detectar oscilación)
+        double hold_s;     // espera tras bajar; se duplica si una subida no se sostuvo
+        long changes;
+        long frames_at[GOV_LEVELS];
+        double last_ms; // media de la última ventana
+        int settle;     // frames a ignorar tras un cambio (reconstrucción de la malla)
+    } Governor;
+
+    void gov_init(Governor *G, double target_ms, int max_threads, double user_simhz);
+    // Registra el trabajo del frame (ms). Devuelve 1 si cambió la configuración.
+    int gov_frame(Governor *G, double work_ms);
+    void gov_settings(const Governor *G, GovSettings *out);
+    void gov_print_summary(const Governor *G);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
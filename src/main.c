@@ -6,10 +6,23 @@
 #include <SDL2/SDL.h>
 #ifdef _OPENMP
 #include <omp.h>
+#include "taskgraph.h"
 #endif
 
 #include "sim.h"
 #include "cloth.h"
+#include "cloth_kernels.h"
+#include "record.h"
+#include "pacing.h"
+#include "perfcount.h"
+#include "trace.h"
+#include "dist.h"
+#include "simshm.h"
+#include "governor.h"
+#include "geocap.h"
+#include "energy.h"
+#include "batch.h"
+#include "metrics.h"
 
 enum Mode
 {
@@ -24,10 +37,42 @@ static void print_usage(const char *prog)
 #ifdef _OPENMP
     printf("  --threads T      (OpenMP threads)\n");
     printf("  --nogeom         (diagnostico: fuerza backend secuencial)\n");
+    printf("  --taskgraph      (frame como grafo de tareas con robo de trabajo)\n");
+    printf("  --taskdump FILE  (CSV con inicio/fin de cada tarea por frame; implica --taskgraph)\n");
 #endif
     printf("  --novsync        (desactiva vsync del renderer)\n");
+    printf("  --isa NAME       (kernels: auto|sse2|avx2|avx512; default auto por cpuid)\n");
+    printf("  --frames F       (termina tras F frames; 0 = sin limite)\n");
+    printf("  --simhz H        (simula a H Hz e interpola por frame; 0 = simular cada frame)\n");
+    printf("  --target-ms X    (gobernador: ajusta malla, radio, simhz e hilos para X ms/frame)\n");
+    printf("  --perfcounters   (contadores de hardware por etapa: IPC, misses/esfera, bytes/esfera)\n");
+    printf("  --energy         (energia por frame y por esfera con RAPL, por backend e hilos)\n");
+    printf("  --energy-path P  (zona powercap o archivo de contador en uJ; implica --energy)\n");
+    printf("  --trace FILE     (tramos por hilo en JSON de Chrome trace / Perfetto)\n");
+    printf("  --trace-frames A:B (solo traza los frames A..B y vuelca al terminar B)\n");
+    printf("  --metrics PATH   (metricas en vivo, texto Prometheus, en el socket Unix PATH)\n");
+    printf("  --dist M         (render sort-last en M procesos locales; resolucion de --size)\n");
+    printf("  --publish NAME   (simula una vez y publica cada frame en memoria compartida NAME)\n");
+    printf("  --view NAME      (no simula: dibuja el ultimo frame publicado en NAME)\n");
+    printf("  --geocap FILE    (captura binaria de la geometria de cada frame, hilo escritor)\n");
+    printf("  --geocap-ordered (captura en orden de dibujo: 8 B/esfera en vez de 12)\n");
+    printf("  --replay FILE    (no simula: reproduce en bucle una captura --geocap via mmap)\n");
+    printf("  --sorted-draw    (el sort copia las esferas en orden de dibujo; render lineal)\n");
+    printf("  --palette K      (render secuencial: ~K colores, agrupados por color dentro de cada bin)\n");
+    printf("  --render-scale S (dibuja a S x la resolucion de la ventana y escala al presentar; 0.25..1)\n");
+    printf("  --render-filter F (filtro del escalado: nearest|linear|best; default linear)\n");
+    printf("\nGrabacion:\n");
+    printf("  --record FILE    (graba cada frame; .y4m = YUV 4:2:0, otro = RGBA crudo)\n");
+    printf("  --record-slots K (buffers preasignados del anillo; default 8)\n");
+    printf("  --record-only    (sin pantalla: render por software, dt fijo 1/fps)\n");
+    printf("  --size WxH       (resolucion en --record-only y --batch; default 1280x720)\n");
+    printf("  --batch M        (offline: M procesos renderizan frames completos en paralelo; requiere\n");
+    printf("                    --record y --frames; FILE con %%d = un PPM por frame)\n");
     printf("\nModo cloth (manta):\n");
     printf("  --grid GXxGY     (p. ej. 180x100; si se omite, se deriva de N/aspecto)\n");
+    printf("  --grid-max GXxGY (reserva de entrada para cambiar la grilla en vivo hasta ese tamano)\n");
+    printf("  --grid-cycle S   (alterna cada S segundos entre la grilla inicial y --grid-max o el doble)\n");
+    printf("  teclas + / -     (grilla x5/4 o x4/5 en vivo, sin reiniciar la simulacion)\n");
     printf("  --tilt DEG       (inclinacion X en grados)\n");
     printf("  --fov  F         (campo de vision; ~1.0..2.2)\n");
     printf("  --zcam Z         (posicion camara; mas cerca: -3.0)\n");
@@ -37,6 +82,125 @@ static void print_usage(const char *prog)
     printf("  --panX px / --panY px / --center 0|1\n");
 }
 
+// Mediana de los últimos frames normales: referencia de los picos al
+// cambiar la grilla
+#define GRID_HIST 64
+
+static int cmp_double(const void *a, const void *b)
+{
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median_ms(const double *v, int n)
+{
+    if (n <= 0)
+        return 0.0;
+    double tmp[GRID_HIST];
+    memcpy(tmp, v, sizeof(double) * (size_t)n);
+    qsort(tmp, (size_t)n, sizeof(double), cmp_double);
+    return tmp[n / 2];
+}
+
+// Frames con la grilla nueva que sirven de referencia para el frame del cambio
+#define GRID_SETTLE 8
+
+// Seguimiento de un cambio de grilla en vivo. Fase 1: la malla nueva se
+// arma por tramos mientras se simula la vieja (peor frame frente a la
+// mediana previa). Fase 2: el frame que adopta la grilla se compara con la
+// mediana de los GRID_SETTLE frames siguientes, que ya tienen la carga nueva.
+typedef struct
+{
+    int phase; // 0 = sin cambio, 1 = armando la malla, 2 = midiendo la grilla nueva
+    int fromGX, fromGY;
+    long frames;
+    double build_worst, build_base; // build_base < 0: sin frames previos
+    double switch_ms;               // frame que adoptó la grilla nueva
+    double hist[GRID_HIST];         // work_ms de los frames sin cambio en curso
+    int nhist, ihist;
+    long count;
+    double spike_max, spike_sum; // switch_ms - mediana de la grilla nueva
+} GridChange;
+
+static void grid_push(GridChange *gc, double ms)
+{
+    gc->hist[gc->ihist] = ms;
+    gc->ihist = (gc->ihist + 1) % GRID_HIST;
+    if (gc->nhist < GRID_HIST)
+        gc->nhist++;
+}
+
+static void grid_report(GridChange *gc, const ClothState *S)
+{
+    const double base = median_ms(gc->hist, gc->nhist);
+    printf("grid: %dx%d -> %dx%d, malla nueva en %ld frames", gc->fromGX, gc->fromGY, S->P.GX, S->P.GY,
+           gc->frames);
+    // Frames que armaron la malla con la grilla vieja (el último ya es el cambio)
+    if (gc->frames > 1)
+    {
+        printf(" (peor %.2f ms", gc->build_worst);
+        if (gc->build_base >= 0.0)
+            printf(", mediana previa %.2f ms", gc->build_base);
+        printf(")");
+    }
+    printf(", frame del cambio %.2f ms", gc->switch_ms);
+    if (gc->nhist > 0)
+    {
+        const double spike = gc->switch_ms - base;
+        printf(" (mediana con la grilla nueva %.2f ms)", base);
+        gc->spike_sum += spike;
+        if (gc->count == 0 || spike > gc->spike_max)
+            gc->spike_max = spike;
+        gc->count++;
+    }
+    printf("\n");
+    gc->phase = 0;
+}
+
+static void grid_request(GridChange *gc, ClothState *S, int GX, int GY)
+{
+    const int fromGX = S->P.GX, fromGY = S->P.GY;
+    if (gc->phase == 2)
+        grid_report(gc, S);
+    const int r = cloth_resize(S, GX < 2 ? 2 : GX, GY < 2 ? 2 : GY, 0.0f);
+    if (r < 0)
+        fprintf(stderr, "grid: no se puede cambiar a %dx%d\n", GX, GY);
+    else if (r == 0)
+        gc->phase = 0; // se volvió a la grilla actual antes de adoptar la otra
+    else if (gc->phase == 0)
+    {
+        gc->phase = 1;
+        gc->fromGX = fromGX;
+        gc->fromGY = fromGY;
+        gc->frames = 0;
+        gc->build_worst = 0.0;
+        gc->build_base = gc->nhist > 0 ? median_ms(gc->hist, gc->nhist) : -1.0;
+    }
+}
+
+static void grid_frame(GridChange *gc, const ClothState *S, double work_ms)
+{
+    if (gc->phase == 1 && !cloth_resize_pending(S))
+    {
+        // Este frame adoptó la grilla: la historia previa ya no es comparable
+        gc->frames++;
+        gc->switch_ms = work_ms;
+        gc->phase = 2;
+        gc->nhist = gc->ihist = 0;
+        return;
+    }
+    if (gc->phase == 1)
+    {
+        gc->frames++;
+        if (work_ms > gc->build_worst)
+            gc->build_worst = work_ms;
+        return;
+    }
+    grid_push(gc, work_ms);
+    if (gc->phase == 2 && gc->nhist >= GRID_SETTLE)
+        grid_report(gc, S);
+}
+
 static int parse_grid(const char *s, int *GX, int *GY)
 {
     int a = 0, b = 0;
@@ -49,6 +213,103 @@ static int parse_grid(const char *s, int *GX, int *GY)
     return 0;
 }
 
+// Las posiciones de --view/--replay están en píxeles de otro proceso o
+// captura: el renderer escala ese espacio a la ventana
+static void set_logical_size(SDL_Renderer *R, int W, int H)
+{
+    int lw = 0, lh = 0;
+    SDL_RenderGetLogicalSize(R, &lw, &lh);
+    if (lw != W || lh != H)
+        SDL_RenderSetLogicalSize(R, W, H);
+}
+
+// Textura destino de --render-scale: se recrea solo si cambia el tamaño
+static SDL_Texture *ensure_render_target(SDL_Renderer *R, SDL_Texture *rt, int *rtW, int *rtH, int RW, int RH,
+                                         SDL_ScaleMode filter)
+{
+    if (rt && *rtW == RW && *rtH == RH)
+        return rt;
+    if (rt)
+        SDL_DestroyTexture(rt);
+    rt = SDL_CreateTexture(R, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, RW, RH);
+    if (!rt)
+    {
+        fprintf(stderr, "render-scale: no se pudo crear el destino %dx%d (%s)\n", RW, RH, SDL_GetError());
+        return NULL;
+    }
+    SDL_SetTextureScaleMode(rt, filter);
+    *rtW = RW;
+    *rtH = RH;
+    return rt;
+}
+
+static int scaled_dim(int v, float s)
+{
+    const int r = (int)lroundf((float)v * s);
+    return r > 0 ? r : 1;
+}
+
+// Backend de dibujo según el binario y --nogeom
+static void render_cloth(SDL_Renderer *R, const ClothState *S, bool par)
+{
+#ifdef _OPENMP
+    if (par)
+        cloth_render_omp(R, S);
+    else
+        cloth_render_seq(R, S);
+#else
+    (void)par;
+    cloth_render_seq(R, S);
+#endif
+}
+
+// ms desde *t0; deja *t0 en el instante actual (tramos consecutivos del frame)
+static double lap_ms(Uint64 *t0)
+{
+    const Uint64 now = SDL_GetPerformanceCounter();
+    const double ms = 1000.0 * (double)(now - *t0) / (double)SDL_GetPerformanceFrequency();
+    *t0 = now;
+    return ms;
+}
+
+// Inicialización de la tela en otro hilo mientras se crean la ventana y el renderer
+typedef struct
+{
+    ClothState *S;
+    ClothParams P;
+    int W, H;
+    int threads; // --threads (0 = por defecto)
+    int rc;
+    double ms;
+    SDL_atomic_t done;
+} ClothInitJob;
+
+static int cloth_init_main(void *arg)
+{
+    ClothInitJob *job = (ClothInitJob *)arg;
+    trace_thread_name("cloth-init");
+#ifdef _OPENMP
+    // El número de hilos de OpenMP es por hilo: el equipo de este también respeta --threads
+    if (job->threads > 0)
+        omp_set_num_threads(job->threads);
+#endif
+    const Uint64 t0 = SDL_GetPerformanceCounter();
+    TraceSpan sp = trace_begin("cloth-init");
+    job->rc = cloth_init_buffers(job->S, &job->P, job->W, job->H);
+    trace_end(sp);
+    job->ms = 1000.0 * (double)(SDL_GetPerformanceCounter() - t0) / (double)SDL_GetPerformanceFrequency();
+    SDL_AtomicSet(&job->done, 1);
+    return 0;
+}
+
+static void print_rec_stats(Recorder *rec)
+{
+    RecStats st;
+    rec_get_stats(rec, &st);
+    printf("record: enviados=%llu escritos=%llu descartados=%llu cola=%u (max %u)\n",
+           st.submitted, st.written, st.dropped, st.queued, st.queued_max);
+}
+
 int main(int argc, char *argv[])
 {
     if (argc < 2)
@@ -57,13 +318,40 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    // Origen del tiempo hasta el primer frame
+    const Uint64 t_start = SDL_GetPerformanceCounter();
     int N = atoi(argv[1]);
     enum Mode mode = MODE_CLOTH;
     int fpscap = 0; // 0 = sin limite
     bool vsync_on = true;
+    long max_frames = 0; // 0 = sin limite
+    double simhz = 0.0;  // 0 = cloth_update en cada frame
+    double target_ms = 0.0; // --target-ms: 0 = calidad fija
+    const char *isa = "auto";
+    bool perfcounters = false;
+    bool energy = false;
+    const char *energy_path = NULL; // NULL = autodetección en /sys/class/powercap
+    const char *trace_path = NULL;
+    const char *metrics_path = NULL; // --metrics: socket Unix con métricas Prometheus
+    int dist_workers = 0; // --dist M: 0 = render en este proceso
+    int batch_workers = 0; // --batch M: render offline de frames en paralelo
+    const char *shm_pub = NULL, *shm_view = NULL; // --publish / --view
+    const char *geocap_path = NULL, *replay_path = NULL;
+    bool geocap_ordered = false;
+    int grid_max_GX = 0, grid_max_GY = 0; // --grid-max: reserva para la grilla en vivo
+    double grid_cycle = 0.0;              // --grid-cycle: segundos entre cambios (0 = no)
+    float render_scale = 1.0f; // --render-scale: 1 = dibuja directo a la ventana
+    SDL_ScaleMode render_filter = SDL_ScaleModeLinear;
+    long trace_f0 = 0, trace_f1 = -1;
+    const char *rec_path = NULL;
+    int rec_slots = 8;
+    bool headless = false; // --record-only: sin ventana, render a una surface
+    int headW = 1280, headH = 720;
 #ifdef _OPENMP
     bool noGeom = false; // fuerza backend secuencial desde el binario paralelo
     int threads = 0;     // 0 -> decide runtime
+    bool use_tg = false; // --taskgraph
+    const char *tg_dump_path = NULL;
 #endif
 
     // ---- Parametros CLOTH (con defaults defensivos) ----
@@ -111,12 +399,157 @@ int main(int argc, char *argv[])
         else if (!strcmp(argv[i], "--nogeom"))
         {
             noGeom = true;
+        }
+        else if (!strcmp(argv[i], "--taskgraph"))
+        {
+            use_tg = true;
+        }
+        else if (!strcmp(argv[i], "--taskdump") && i + 1 < argc)
+        {
+            tg_dump_path = argv[++i];
+            use_tg = true;
 #endif
         }
         else if (!strcmp(argv[i], "--novsync"))
         {
             vsync_on = false;
         }
+        else if (!strcmp(argv[i], "--isa") && i + 1 < argc)
+        {
+            isa = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            max_frames = atol(argv[++i]);
+            if (max_frames < 0)
+                max_frames = 0;
+        }
+        else if (!strcmp(argv[i], "--simhz") && i + 1 < argc)
+        {
+            simhz = atof(argv[++i]);
+            if (simhz < 0.0)
+                simhz = 0.0;
+        }
+        else if (!strcmp(argv[i], "--target-ms") && i + 1 < argc)
+        {
+            target_ms = atof(argv[++i]);
+            if (target_ms < 0.0)
+                target_ms = 0.0;
+        }
+        else if (!strcmp(argv[i], "--perfcounters"))
+        {
+            perfcounters = true;
+        }
+        else if (!strcmp(argv[i], "--energy"))
+        {
+            energy = true;
+        }
+        else if (!strcmp(argv[i], "--energy-path") && i + 1 < argc)
+        {
+            energy = true;
+            energy_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--dist") && i + 1 < argc)
+        {
+            dist_workers = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--batch") && i + 1 < argc)
+        {
+            batch_workers = atoi(argv[++i]);
+            if (batch_workers < 1)
+                batch_workers = 1;
+        }
+        else if (!strcmp(argv[i], "--publish") && i + 1 < argc)
+        {
+            shm_pub = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--view") && i + 1 < argc)
+        {
+            shm_view = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--geocap") && i + 1 < argc)
+        {
+            geocap_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--geocap-ordered"))
+        {
+            geocap_ordered = true;
+        }
+        else if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+        {
+            replay_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--sorted-draw"))
+        {
+            CP.sortedDraw = 1;
+        }
+        else if (!strcmp(argv[i], "--palette") && i + 1 < argc)
+        {
+            CP.palette = atoi(argv[++i]);
+            if (CP.palette < 0)
+                CP.palette = 0;
+        }
+        else if (!strcmp(argv[i], "--render-scale") && i + 1 < argc)
+        {
+            render_scale = (float)atof(argv[++i]);
+            if (!(render_scale > 0.0f) || render_scale > 1.0f)
+                render_scale = 1.0f;
+            else if (render_scale < 0.25f)
+                render_scale = 0.25f;
+        }
+        else if (!strcmp(argv[i], "--render-filter") && i + 1 < argc)
+        {
+            const char *f = argv[++i];
+            if (!strcmp(f, "nearest"))
+                render_filter = SDL_ScaleModeNearest;
+            else if (!strcmp(f, "linear"))
+                render_filter = SDL_ScaleModeLinear;
+            else if (!strcmp(f, "best"))
+                render_filter = SDL_ScaleModeBest;
+            else
+            {
+                fprintf(stderr, "--render-filter invalido: use nearest, linear o best\n");
+                return 2;
+            }
+        }
+        else if (!strcmp(argv[i], "--metrics") && i + 1 < argc)
+        {
+            metrics_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+        {
+            trace_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--trace-frames") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ld:%ld", &trace_f0, &trace_f1) != 2 || trace_f0 < 0 || trace_f1 < trace_f0)
+            {
+                fprintf(stderr, "Formato --trace-frames invalido. Use A:B, p.ej. 100:400\n");
+                return 2;
+            }
+        }
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+        {
+            rec_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--record-slots") && i + 1 < argc)
+        {
+            rec_slots = atoi(argv[++i]);
+            if (rec_slots < 2)
+                rec_slots = 2;
+        }
+        else if (!strcmp(argv[i], "--record-only"))
+        {
+            headless = true;
+        }
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc)
+        {
+            if (!parse_grid(argv[++i], &headW, &headH))
+            {
+                fprintf(stderr, "Formato --size invalido. Use WxH, p.ej. 1920x1080\n");
+                return 2;
+            }
+        }
         else if (!strcmp(argv[i], "--grid") && i + 1 < argc)
         {
             if (!parse_grid(argv[++i], &CP.GX, &CP.GY))
@@ -125,6 +558,20 @@ int main(int argc, char *argv[])
                 return 2;
             }
         }
+        else if (!strcmp(argv[i], "--grid-max") && i + 1 < argc)
+        {
+            if (!parse_grid(argv[++i], &grid_max_GX, &grid_max_GY))
+            {
+                fprintf(stderr, "--grid-max invalido: use GXxGY\n");
+                return 2;
+            }
+        }
+        else if (!strcmp(argv[i], "--grid-cycle") && i + 1 < argc)
+        {
+            grid_cycle = atof(argv[++i]);
+            if (grid_cycle < 0.0)
+                grid_cycle = 0.0;
+        }
         else if (!strcmp(argv[i], "--tilt") && i + 1 < argc)
         {
             CP.tiltX_deg = (float)atof(argv[++i]);
@@ -199,8 +646,152 @@ int main(int argc, char *argv[])
     if (threads > 0)
         omp_set_num_threads(threads);
 #endif
+    // Elige la variante de kernels antes de cloth_init (el sprite ya la usa).
+    // Una ISA pedida explícitamente que no existe o la CPU no soporta es un
+    // error: medir con otra variante sin avisar falsearía la comparación.
+    if (!cloth_kernels_select(isa))
+    {
+        fprintf(stderr, "--isa %s no está disponible en esta CPU (ver la línea 'cpu:' con las soportadas)\n", isa);
+        return 2;
+    }
+    // Offline por lotes: los trabajadores se crean con fork antes de SDL_Init
+    // y el proceso termina al escribir el último frame
+    if (batch_workers > 0)
+    {
+        if (dist_workers > 0 || shm_pub || shm_view || replay_path || geocap_path)
+        {
+            fprintf(stderr, "--batch es incompatible con --dist, --publish, --view, --replay y --geocap\n");
+            return 2;
+        }
+        if (!rec_path || max_frames <= 0)
+        {
+            fprintf(stderr, "--batch requiere --record FILE y --frames F\n");
+            return 2;
+        }
+        if ((CP.GX <= 0 || CP.GY <= 0) && N > 0)
+        {
+            CP.GX = N;
+            CP.GY = 1;
+        }
+#ifdef _OPENMP
+        const int batch_threads = (threads > 0) ? threads : omp_get_max_threads();
+#else
+        const int batch_threads = 1;
+#endif
+        // dt fijo 1/fps, igual que --record-only
+        return batch_run(&CP, headW, headH, max_frames, (fpscap > 0) ? fpscap : 60, batch_workers, batch_threads,
+                         rec_path, rec_slots) == 0
+                   ? 0
+                   : 6;
+    }
+    if ((shm_pub || shm_view) && (dist_workers > 0 || (shm_pub && shm_view)))
+    {
+        fprintf(stderr, "--publish, --view y --dist son excluyentes\n");
+        return 2;
+    }
+    // Visor: la malla y el radio vienen del productor; no simula
+    SimShm *shm = NULL;
+    if (shm_view)
+    {
+        shm = simshm_open(shm_view);
+        if (!shm)
+            return 2;
+        simshm_params(shm, &CP);
+    }
+    // Reproducción: la malla y el radio vienen de la captura; no simula
+    GeoReplay *replay = NULL;
+    if (replay_path)
+    {
+        if (shm_view || dist_workers > 0 || geocap_path)
+        {
+            fprintf(stderr, "--replay es incompatible con --view, --dist y --geocap\n");
+            return 2;
+        }
+        replay = georeplay_open(replay_path);
+        if (!replay)
+            return 2;
+        georeplay_params(replay, &CP);
+    }
+    if ((shm_pub || shm_view || replay) && simhz > 0.0)
+    {
+        fprintf(stderr, "--publish/--view/--replay ignoran --simhz\n");
+        simhz = 0.0;
+    }
+#ifdef _OPENMP
+    if (shm_view || replay)
+        use_tg = false;
+#endif
+    // Los trabajadores se crean con fork antes de SDL_Init y de cualquier hilo
+    DistCluster *dist = NULL;
+    if (dist_workers > 0)
+    {
+        if (CP.GX <= 0 || CP.GY <= 0)
+        {
+            fprintf(stderr, "--dist requiere --grid GXxGY\n");
+            return 2;
+        }
+#ifdef _OPENMP
+        int dist_threads = (threads > 0) ? threads : omp_get_max_threads();
+#else
+        int dist_threads = 1;
+#endif
+        dist = dist_start(dist_workers, &CP, headW, headH, dist_threads);
+        if (!dist)
+            return 2;
+        if (simhz > 0.0)
+            fprintf(stderr, "--dist ignora --simhz\n");
+        simhz = 0.0;
+#ifdef _OPENMP
+        use_tg = false;
+#endif
+    }
+    // --render-scale: la simulación local trabaja en el espacio reducido, así
+    // que el radio y el paneo dados en píxeles de ventana se escalan igual.
+    // --view/--replay dibujan en el espacio de otro proceso y --dist ya
+    // compone a la resolución de --size.
+    if (render_scale < 1.0f && (shm_view || replay || dist))
+    {
+        fprintf(stderr, "--render-scale se ignora con --view, --replay o --dist\n");
+        render_scale = 1.0f;
+    }
+    const bool scaled = render_scale < 1.0f;
+    // --sorted-draw: los visores y la captura cruda leen order_idx; con
+    // --simhz (o si el gobernador lo activa) el render usa el estado
+    // interpolado, que se ordena por índice.
+    if (CP.sortedDraw && (shm_view || replay || dist))
+    {
+        fprintf(stderr, "--sorted-draw se ignora con --view, --replay o --dist\n");
+        CP.sortedDraw = 0;
+    }
+    if (CP.sortedDraw && simhz > 0.0)
+        fprintf(stderr, "--sorted-draw no acelera el render con --simhz (se dibuja el estado interpolado)\n");
+    CP.keepOrder = (shm_pub || geocap_path || simhz > 0.0 || target_ms > 0.0) ? 1 : 0;
+    if (scaled)
+    {
+        CP.baseRadius *= render_scale;
+        CP.panX_px *= render_scale;
+        CP.panY_px *= render_scale;
+    }
+    // Después de fijar el número de hilos: cada hilo del equipo abre los suyos
+    if (perfcounters)
+        perf_open();
+    if (energy)
+        energy_open(energy_path);
+    // Antes de crear hilos propios (grafo de tareas, grabador) para nombrarlos
+    if (trace_path && !trace_open(trace_path, trace_f0, trace_f1))
+        return 2;
+    // Sin socket se sigue sin métricas (ya se avisó)
+    if (metrics_path)
+        metrics_open(metrics_path);
+
+    if (headless && !rec_path)
+    {
+        fprintf(stderr, "--record-only requiere --record FILE\n");
+        return 2;
+    }
 
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0)
+    // En modo solo-captura no se inicializa video: basta el renderer por software
+    if (SDL_Init(headless ? SDL_INIT_TIMER : (SDL_INIT_VIDEO | SDL_INIT_TIMER)) != 0)
     {
         fprintf(stderr, "SDL_Init error: %s\n", SDL_GetError());
         return 3;
@@ -209,36 +800,36 @@ int main(int argc, char *argv[])
     SDL_SetHint(SDL_HINT_RENDER_BATCHING, "1");
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
 
-    SDL_DisplayMode DM;
-    if (SDL_GetCurrentDisplayMode(0, &DM) != 0)
+    SDL_Window *win = NULL;
+    SDL_Surface *frame_surf = NULL; // framebuffer CPU del modo headless
+    SDL_Renderer *R = NULL;
+    int W, H;
+    if (headless)
     {
-        DM.w = 1280;
-        DM.h = 720;
+        W = headW;
+        H = headH;
     }
-    int W = DM.w, H = DM.h;
-
-    SDL_Window *win = SDL_CreateWindow("Screensaver",
-                                       SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, W, H, SDL_WINDOW_RESIZABLE);
-    if (!win)
-    {
-        fprintf(stderr, "SDL_CreateWindow error: %s\n", SDL_GetError());
-        SDL_Quit();
-        return 4;
-    }
-    SDL_MaximizeWindow(win);
-
-    Uint32 rflags = SDL_RENDERER_ACCELERATED | (vsync_on ? SDL_RENDERER_PRESENTVSYNC : 0);
-    SDL_Renderer *R = SDL_CreateRenderer(win, -1, rflags);
-    if (!R)
+    else
     {
-        fprintf(stderr, "SDL_CreateRenderer error: %s\n", SDL_GetError());
-        SDL_DestroyWindow(win);
-        SDL_Quit();
-        return 4;
+        SDL_DisplayMode DM;
+        if (SDL_GetCurrentDisplayMode(0, &DM) != 0)
+        {
+            DM.w = 1280;
+            DM.h = 720;
+        }
+        W = DM.w;
+        H = DM.h;
     }
 
+    // La tela se inicializa con el tamaño inicial (el del escritorio, como la
+    // ventana antes de maximizar) en otro hilo: buffers, malla y sprite se
+    // preparan mientras se crean y maximizan la ventana y el renderer. Solo
+    // la textura del sprite espera al hilo de SDL.
     ClothState CS;
     memset(&CS, 0, sizeof(CS));
+    ClothInitJob init_job;
+    memset(&init_job, 0, sizeof(init_job));
+    SDL_Thread *init_thr = NULL;
     if (mode == MODE_CLOTH)
     {
         if ((CP.GX <= 0 || CP.GY <= 0) && N > 0)
@@ -246,28 +837,212 @@ int main(int argc, char *argv[])
             CP.GX = N;
             CP.GY = 1;
         } // derive
-        if (cloth_init(R, &CS, &CP, W, H) != 0)
+        init_job.S = &CS;
+        init_job.P = CP;
+        init_job.W = scaled ? scaled_dim(W, render_scale) : W;
+        init_job.H = scaled ? scaled_dim(H, render_scale) : H;
+#ifdef _OPENMP
+        init_job.threads = threads;
+#endif
+        init_thr = SDL_CreateThread(cloth_init_main, "cloth-init", &init_job);
+        if (!init_thr)
+            cloth_init_main(&init_job);
+    }
+
+    if (headless)
+    {
+        frame_surf = SDL_CreateRGBSurfaceWithFormat(0, W, H, 32, SDL_PIXELFORMAT_RGBA32);
+        R = frame_surf ? SDL_CreateSoftwareRenderer(frame_surf) : NULL;
+        if (!R)
+        {
+            fprintf(stderr, "SDL_CreateSoftwareRenderer error: %s\n", SDL_GetError());
+            SDL_WaitThread(init_thr, NULL);
+            if (frame_surf)
+                SDL_FreeSurface(frame_surf);
+            SDL_Quit();
+            return 4;
+        }
+    }
+    else
+    {
+        win = SDL_CreateWindow("Screensaver",
+                               SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, W, H, SDL_WINDOW_RESIZABLE);
+        if (!win)
+        {
+            fprintf(stderr, "SDL_CreateWindow error: %s\n", SDL_GetError());
+            SDL_WaitThread(init_thr, NULL);
+            SDL_Quit();
+            return 4;
+        }
+        SDL_MaximizeWindow(win);
+
+        Uint32 rflags = SDL_RENDERER_ACCELERATED | (vsync_on ? SDL_RENDERER_PRESENTVSYNC : 0);
+        R = SDL_CreateRenderer(win, -1, rflags);
+        if (!R)
         {
-            fprintf(stderr, "Error inicializando CLOTH\n");
-            SDL_DestroyRenderer(R);
+            fprintf(stderr, "SDL_CreateRenderer error: %s\n", SDL_GetError());
+            SDL_WaitThread(init_thr, NULL);
             SDL_DestroyWindow(win);
             SDL_Quit();
-            return 5;
+            return 4;
         }
     }
 
+    // Placeholder: fondo liso hasta que la tela esté lista. Solo se bombean
+    // los eventos; un cierre queda en la cola para el bucle principal.
+    double placeholder_ms = -1.0;
+    while (win && init_thr && !SDL_AtomicGet(&init_job.done))
+    {
+        SDL_PumpEvents();
+        SDL_SetRenderDrawColor(R, 0, 0, 0, 255);
+        SDL_RenderClear(R);
+        SDL_RenderPresent(R);
+        if (placeholder_ms < 0.0)
+            placeholder_ms = 1000.0 * (double)(SDL_GetPerformanceCounter() - t_start) /
+                             (double)SDL_GetPerformanceFrequency();
+        if (!vsync_on)
+            SDL_Delay(1);
+    }
+    SDL_WaitThread(init_thr, NULL);
+    if (mode == MODE_CLOTH && (init_job.rc != 0 || cloth_init_finish(R, &CS) != 0))
+    {
+        fprintf(stderr, "Error inicializando CLOTH\n");
+        cloth_destroy(&CS);
+        SDL_DestroyRenderer(R);
+        if (win)
+            SDL_DestroyWindow(win);
+        if (frame_surf)
+            SDL_FreeSurface(frame_surf);
+        SDL_Quit();
+        return 5;
+    }
+    // Productor: el anillo se dimensiona con el estado ya inicializado
+    if (shm_pub)
+    {
+        shm = simshm_create(shm_pub, &CS);
+        if (!shm)
+            fprintf(stderr, "Se sigue sin publicar\n");
+    }
+    int view_W = 0, view_H = 0; // espacio de píxeles del productor o de la captura
+    GeoCapture *geocap = NULL;
+    if (geocap_path && dist)
+        fprintf(stderr, "--geocap no aplica con --dist (no hay geometria por esfera)\n");
+    else if (geocap_path)
+        geocap = geocap_open(geocap_path, &CS, geocap_ordered, rec_slots);
+    // Imagen compuesta por los trabajadores, escalada a la ventana
+    SDL_Texture *dist_tex = NULL;
+    if (dist)
+    {
+        dist_tex = SDL_CreateTexture(R, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, headW, headH);
+        if (!dist_tex)
+            fprintf(stderr, "SDL_CreateTexture error: %s\n", SDL_GetError());
+    }
+
+    // Destino reducido de --render-scale; se escala a la ventana en una copia
+    SDL_Texture *render_rt = NULL;
+    int rt_W = 0, rt_H = 0;
+    if (scaled)
+        printf("render: escala %.2f (%dx%d -> %dx%d), filtro %s\n", (double)render_scale,
+               scaled_dim(W, render_scale), scaled_dim(H, render_scale), W, H,
+               render_filter == SDL_ScaleModeNearest ? "nearest"
+                                                     : (render_filter == SDL_ScaleModeBest ? "best" : "linear"));
+
     int running = 1;
-    Uint32 last = SDL_GetTicks();
     float t = 0.0f;
+    // Ritmo de frames de alta resolución; en headless no se espera (dt fijo)
+    FramePacer pacer;
+    pacer_init(&pacer, headless ? 0 : fpscap);
+    PacerStats pstats = {0};
+    // Estados de simulación para interpolar cuando --simhz > 0
+    ClothInterp interp;
+    memset(&interp, 0, sizeof(interp));
+    long sim_steps = 0;
+    // Hilo de simulación: el paso siguiente se calcula mientras se dibuja el
+    // frame y queda en CS hasta que t lo alcanza (sim_ready_t < 0 = ninguno).
+    // Se crea al primer frame con --simhz (el gobernador puede activarlo).
+    ClothSim *sim = NULL;
+    bool sim_failed = false;
+    double sim_ready_t = -1.0;
+    ClothState sim_snap; // parámetros y sprite de CS al último push
+    memset(&sim_snap, 0, sizeof(sim_snap));
     int frame_count = 0, fps = 0;
     Uint32 fps_timer = SDL_GetTicks();
+    long frames_done = 0;
+    // El grabador se abre en el primer frame, con el tamaño real del drawable
+    // (SDL_GetRendererOutputSize: en pantallas HiDPI no coincide con W x H)
+    Recorder *rec = NULL;
+    int rec_W = W, rec_H = H;
+    bool rec_failed = false;
+    const int rec_fps = (fpscap > 0) ? fpscap : 60;
 
 #ifdef _OPENMP
     int omp_on = 1;
     int omp_threads = (threads > 0) ? threads : omp_get_max_threads();
+    // Pool persistente del grafo de tareas (mismo número de hilos que OpenMP)
+    TaskGraph *tgraph = NULL;
+    FILE *tg_dump = NULL;
+    double tg_idle_acc = 0.0, tg_span_acc = 0.0, tg_idle_win = 0.0;
+    long tg_frames = 0, tg_frames_win = 0;
+    double tg_idle_shown = 0.0;
+    if (use_tg && perf_enabled())
+        fprintf(stderr, "--perfcounters no mide las tareas de --taskgraph (solo regiones OpenMP)\n");
+    if (use_tg && (simhz > 0.0 || noGeom))
+        fprintf(stderr, "--taskgraph se ignora con --simhz o --nogeom\n");
+    else if (use_tg)
+    {
+        tgraph = tg_create(omp_threads);
+        if (!tgraph)
+            fprintf(stderr, "No se pudo crear el grafo de tareas; se usa OpenMP\n");
+        if (tgraph && tg_dump_path)
+        {
+            tg_dump = fopen(tg_dump_path, "w");
+            if (tg_dump)
+                fprintf(tg_dump, "frame,tarea,nombre,hilo,inicio_us,fin_us\n");
+            else
+                fprintf(stderr, "No se pudo abrir %s\n", tg_dump_path);
+        }
+    }
+    const bool par_geom = omp_on && !noGeom;
 #else
     int omp_on = 0, omp_threads = 1;
+    const bool par_geom = false;
 #endif
+    // Gobernador de calidad: la malla se reconstruye a escala de la inicial
+    // y el radio se reescala desde el radio base ya resuelto
+    Governor gov;
+    const bool governed = target_ms > 0.0 && !dist && !shm && !replay;
+    const int base_GX = CS.P.GX, base_GY = CS.P.GY;
+    const float base_radius = CS.P.baseRadius;
+    if (target_ms > 0.0 && !governed)
+        fprintf(stderr, "--target-ms se ignora con --dist, --publish, --view o --replay\n");
+    if (governed)
+        gov_init(&gov, target_ms, omp_threads, simhz);
+    // Ventana oculta o minimizada: no se simula ni se dibuja (salvo el
+    // productor de --publish, que alimenta a otros visores)
+    bool hidden = false;
+    double hidden_s = 0.0;
+    // Grilla en vivo: solo cuando este proceso simula la malla completa (las
+    // capturas y el anillo de --publish tienen capacidad fija)
+    const bool live_grid = !dist && !shm && !replay && !geocap;
+    GridChange grid_chg;
+    memset(&grid_chg, 0, sizeof(grid_chg));
+    const int cycle_GX = grid_max_GX > 0 ? grid_max_GX : 2 * base_GX;
+    const int cycle_GY = grid_max_GY > 0 ? grid_max_GY : 2 * base_GY;
+    double grid_cycle_next = grid_cycle;
+    if ((grid_max_GX > 0 || grid_cycle > 0.0) && !live_grid)
+        fprintf(stderr, "--grid-max/--grid-cycle se ignoran con --dist, --publish, --view, --replay o --geocap\n");
+    else if (grid_max_GX > 0)
+    {
+        const Uint64 r0 = SDL_GetPerformanceCounter();
+        const size_t maxN = (size_t)grid_max_GX * (size_t)grid_max_GY;
+        if (cloth_reserve(&CS, maxN) != 0)
+            fprintf(stderr, "grid: no se pudo reservar para %dx%d\n", grid_max_GX, grid_max_GY);
+        else
+            printf("grid: reservado para %dx%d (%zu esferas) en %.1f ms\n", grid_max_GX, grid_max_GY, maxN,
+                   1000.0 * (double)(SDL_GetPerformanceCounter() - r0) / (double)SDL_GetPerformanceFrequency());
+    }
+    // La energía de la inicialización no se atribuye a ningún frame
+    energy_resync();
 
     while (running)
     {
@@ -278,60 +1053,483 @@ int main(int argc, char *argv[])
                 running = 0;
             if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE)
                 running = 0;
+            if (e.type == SDL_KEYDOWN && live_grid)
+            {
+                // Desde la grilla pendiente si hay una: varias pulsaciones se acumulan
+                const SDL_Keycode k = e.key.keysym.sym;
+                const int gx = cloth_resize_pending(&CS) ? CS.next_GX : CS.P.GX;
+                const int gy = cloth_resize_pending(&CS) ? CS.next_GY : CS.P.GY;
+                if (k == SDLK_PLUS || k == SDLK_EQUALS || k == SDLK_KP_PLUS)
+                    grid_request(&grid_chg, &CS, (gx * 5 + 2) / 4, (gy * 5 + 2) / 4);
+                else if (k == SDLK_MINUS || k == SDLK_KP_MINUS)
+                    grid_request(&grid_chg, &CS, (gx * 4 + 2) / 5, (gy * 4 + 2) / 5);
+            }
+            if (e.type == SDL_WINDOWEVENT)
+            {
+                if (e.window.event == SDL_WINDOWEVENT_HIDDEN || e.window.event == SDL_WINDOWEVENT_MINIMIZED)
+                    hidden = true;
+                else if (e.window.event == SDL_WINDOWEVENT_SHOWN || e.window.event == SDL_WINDOWEVENT_RESTORED ||
+                         e.window.event == SDL_WINDOWEVENT_EXPOSED || e.window.event == SDL_WINDOWEVENT_MAXIMIZED)
+                    hidden = false;
+            }
+        }
+        if (hidden && running && !(shm && !shm_view))
+        {
+            // Se duerme hasta el próximo evento; el pacer se resincroniza al volver
+            const Uint64 h0 = SDL_GetPerformanceCounter();
+            SDL_WaitEventTimeout(NULL, 100);
+            hidden_s += (double)(SDL_GetPerformanceCounter() - h0) / (double)SDL_GetPerformanceFrequency();
+            energy_resync();
+            continue;
         }
 
-        Uint32 now = SDL_GetTicks();
-        float dt = (now - last) * (1.0f / 1000.0f);
-        if (dt <= 0.f)
-            dt = 1.f / 1000.f;
-        last = now;
-        t += dt;
+        trace_frame(frames_done);
+        TraceSpan sp_frame = trace_begin("frame");
+
+        // t corresponde al instante previsto de present, no al inicio del frame
+        double t_present = pacer_begin(&pacer);
+        const Uint64 work0 = SDL_GetPerformanceCounter();
+        Uint64 lap = work0;
+        if (headless)
+            t = (float)frames_done / (float)rec_fps; // tiempo de simulación determinista
+        else
+            t = (float)t_present;
+        if (grid_cycle > 0.0 && live_grid && !cloth_resize_pending(&CS) && (double)t >= grid_cycle_next)
+        {
+            const bool at_base = CS.P.GX == base_GX && CS.P.GY == base_GY;
+            grid_request(&grid_chg, &CS, at_base ? cycle_GX : base_GX, at_base ? cycle_GY : base_GY);
+            grid_cycle_next = (double)t + grid_cycle;
+        }
 
-        SDL_GetWindowSize(win, &W, &H);
+        if (win)
+            SDL_GetWindowSize(win, &W, &H);
+        // Espacio de dibujo: la ventana o el destino reducido
+        int RW = W, RH = H;
+        if (scaled)
+        {
+            RW = scaled_dim(W, render_scale);
+            RH = scaled_dim(H, render_scale);
+            render_rt = ensure_render_target(R, render_rt, &rt_W, &rt_H, RW, RH, render_filter);
+            if (render_rt)
+                SDL_SetRenderTarget(R, render_rt);
+            else
+            {
+                RW = W;
+                RH = H;
+            }
+        }
         SDL_SetRenderDrawColor(R, 0, 0, 0, 255);
         SDL_RenderClear(R);
 
-        cloth_update(R, &CS, W, H, t);
+        // La tela es función de t: con --simhz se simula el siguiente instante
+        // de la rejilla de simulación (>= t) y el render interpola entre los dos
+        // últimos estados, sin añadir latencia.
+        const ClothState *draw_state = &CS;
+        ClothState view;
+        bool rendered = false;
+        int view_got = 0;
+        // Productor: cloth_update escribe directamente en el slot del anillo
+        const bool publishing = shm && !shm_view && simshm_begin(shm, &CS);
+        TraceSpan sp = trace_begin("update");
+        if (shm_view)
+        {
+            view_got = simshm_acquire(shm, &CS, &view, &view_W, &view_H);
+            if (view_got < 0)
+            {
+                printf("simshm: el productor termino\n");
+                running = 0;
+            }
+            if (view_got > 0)
+            {
+                set_logical_size(R, view_W, view_H);
+                draw_state = &view;
+            }
+            else
+                rendered = true;
+        }
+        else if (replay)
+        {
+            georeplay_view(replay, frames_done, &CS, &view, &view_W, &view_H);
+            set_logical_size(R, view_W, view_H);
+            draw_state = &view;
+        }
+        else if (dist)
+        {
+            const void *img = dist_frame(dist, t);
+            if (img && dist_tex)
+            {
+                SDL_UpdateTexture(dist_tex, NULL, img, headW * 4);
+                SDL_RenderCopy(R, dist_tex, NULL, NULL);
+            }
+            else
+            {
+                fprintf(stderr, "dist: un trabajador dejo de responder\n");
+                running = 0;
+            }
+            sim_steps++;
+            rendered = true;
+        }
+        else if (simhz > 0.0)
+        {
+            // Con perf_stage_* globales, medir exige simular en este hilo
+            if (!sim && !sim_failed && !perf_enabled())
+            {
+                sim = cloth_sim_start(&CS);
+                sim_failed = (sim == NULL);
+                if (sim_failed)
+                    fprintf(stderr, "--simhz: no se pudo crear el hilo de simulacion; se simula en el de render\n");
+            }
+            if (interp.nstates == 0 || (double)t > interp.curr_t || CS.N != interp.N)
+            {
+                double t_next = interp.nstates ? interp.curr_t + 1.0 / simhz : (double)t;
+                if (t_next < (double)t)
+                    t_next = (double)t;
+                // El paso adelantado solo sirve si es justo el que toca
+                // (atrasos grandes o simhz cambiado por el gobernador)
+                if (sim_ready_t != t_next)
+                    cloth_update(NULL, &CS, RW, RH, (float)t_next);
+                sim_ready_t = -1.0;
+                cloth_sync_sprite(R, &CS);
+                cloth_interp_push(&interp, &CS, t_next);
+                sim_snap = CS;
+                sim_steps++;
+            }
+            sim_snap.sprite = CS.sprite; // el sprite solo lo toca este hilo
+            cloth_interp_view(&interp, &sim_snap, (double)t, &view);
+            draw_state = &view;
+            // El paso siguiente corre en el hilo de simulación sobre los
+            // buffers libres de CS mientras se dibuja la vista; se espera al
+            // final del frame, antes de volver a tocar CS
+            if (sim && sim_ready_t < 0.0)
+            {
+                sim_ready_t = interp.curr_t + 1.0 / simhz;
+                cloth_sim_kick(sim, RW, RH, (float)sim_ready_t, omp_threads);
+            }
+        }
 #ifdef _OPENMP
-        if (omp_on && !noGeom)
-            cloth_render_omp(R, &CS);
-        else
-            cloth_render_seq(R, &CS);
-#else
-        cloth_render_seq(R, &CS);
+        else if (tgraph)
+        {
+            // Update y render en un solo grafo: sin barreras entre etapas
+            tg_reset(tgraph);
+            ClothGraphDeps gdeps;
+            cloth_update_graph(tgraph, R, &CS, RW, RH, t, &gdeps);
+            cloth_render_graph(tgraph, R, &CS, &gdeps);
+            tg_run(tgraph);
+            double span_ms, idle_pct;
+            tg_last_stats(tgraph, &span_ms, &idle_pct);
+            tg_span_acc += span_ms;
+            tg_idle_acc += idle_pct;
+            tg_idle_win += idle_pct;
+            tg_frames++;
+            tg_frames_win++;
+            if (tg_dump)
+                tg_dump_csv(tgraph, tg_dump, frames_done);
+            sim_steps++;
+            rendered = true;
+        }
 #endif
+        else
+        {
+            cloth_update(R, &CS, RW, RH, t);
+            sim_steps++;
+        }
+        if (publishing)
+            simshm_commit(shm, &CS, RW, RH);
+        // Se captura lo que se va a dibujar (con --simhz, el estado interpolado)
+        // (el grafo de tareas ya dibujó, pero CS tiene el frame completo)
+        if (geocap && (!rendered || (!dist && !shm_view)))
+            geocap_push(geocap, draw_state, shm_view ? view_W : RW, shm_view ? view_H : RH);
+        trace_end(sp);
+        metrics_stage(MET_UPDATE, lap_ms(&lap));
+        sp = trace_begin("render");
+        if (!rendered)
+        {
+            perf_stage_begin(PERF_ST_RENDER);
+            render_cloth(R, draw_state, par_geom);
+            // Visor: si el productor reescribió el slot durante el dibujo, se
+            // descarta lo dibujado y se intenta con el frame más nuevo
+            for (int k = 0; view_got > 0 && !simshm_release(shm) && k < 2; ++k)
+            {
+                SDL_RenderClear(R);
+                view_got = simshm_acquire(shm, &CS, &view, &view_W, &view_H);
+                if (view_got > 0)
+                    render_cloth(R, draw_state, par_geom);
+            }
+            perf_stage_end(PERF_ST_RENDER, draw_state->N);
+        }
+        trace_end(sp);
+        if (scaled && render_rt)
+        {
+            // Una sola copia filtrada del destino reducido a la ventana
+            sp = trace_begin("upscale");
+            SDL_SetRenderTarget(R, NULL);
+            SDL_RenderCopy(R, render_rt, NULL, NULL);
+            trace_end(sp);
+        }
+        metrics_stage(MET_RENDER, lap_ms(&lap));
 
+        // Se consulta cada frame: si el drawable cambia, rec_capture descarta
+        if (rec_path && !rec_failed && !headless && SDL_GetRendererOutputSize(R, &rec_W, &rec_H) != 0)
+        {
+            rec_W = W;
+            rec_H = H;
+        }
+        if (rec_path && !rec && !rec_failed)
+        {
+            rec = rec_open(rec_path, rec_W, rec_H, rec_fps, rec_slots);
+            rec_failed = (rec == NULL);
+            if (rec_failed && headless)
+                running = 0;
+        }
+        // Ventana: se lee antes de presentar. Headless: se presenta (flush del
+        // batch del renderer por software) y se copia la surface directamente.
+        sp = trace_begin("record");
+        if (rec && !headless)
+            rec_capture(rec, R, rec_W, rec_H);
+        trace_end(sp);
+        double rec_ms = lap_ms(&lap);
+        // Con --fpscap se espera al deadline antes de presentar: los presents
+        // quedan equiespaciados aunque el trabajo por frame varíe.
+        const double work_ms =
+            1000.0 * (double)(SDL_GetPerformanceCounter() - work0) / (double)SDL_GetPerformanceFrequency();
+        sp = trace_begin("pacer-wait");
+        pacer_wait(&pacer);
+        trace_end(sp);
+        metrics_stage(MET_WAIT, lap_ms(&lap));
+        sp = trace_begin("present");
         SDL_RenderPresent(R);
+        pacer_presented(&pacer);
+        trace_end(sp);
+        metrics_stage(MET_PRESENT, lap_ms(&lap));
+        if (frames_done == 0)
+        {
+            const double first_ms =
+                1000.0 * (double)(SDL_GetPerformanceCounter() - t_start) / (double)SDL_GetPerformanceFrequency();
+            metrics_first_frame(first_ms);
+            printf("inicio: primer frame a %.1f ms", first_ms);
+            if (placeholder_ms >= 0.0)
+                printf(" (placeholder a %.1f ms)", placeholder_ms);
+            if (mode == MODE_CLOTH)
+                printf(", tela %.1f ms en paralelo con la ventana", init_job.ms);
+            printf("\n");
+        }
+        sp = trace_begin("record");
+        if (rec && headless)
+            rec_capture_pixels(rec, frame_surf->pixels, frame_surf->pitch, W, H);
+        trace_end(sp);
+        rec_ms += lap_ms(&lap);
+        metrics_stage(MET_RECORD, rec_ms);
+        trace_end_arg(sp_frame, frames_done);
+        const char *backend = dist ? "dist" : (shm_view ? "view" : (par_geom ? "omp" : "seq"));
+#ifdef _OPENMP
+        if (tgraph)
+            backend = "taskgraph";
+#endif
+        // Energía del frame completo (incluida la espera del pacer)
+        if (energy_enabled())
+            energy_frame(backend, omp_threads, draw_state->N);
+        if (metrics_enabled())
+        {
+            metrics_state(draw_state->N, omp_threads, backend);
+            // Las visibles las cuenta el update (con --simhz, el último paso).
+            // En --dist, --view y --replay no corre un update propio.
+            if (!dist && !shm_view && !replay)
+                metrics_visible(draw_state->visible);
+            metrics_frame();
+        }
+
+        cloth_sim_wait(sim);
+        grid_frame(&grid_chg, &CS, work_ms);
+        if (governed && gov_frame(&gov, work_ms))
+        {
+            GovSettings gs;
+            gov_settings(&gov, &gs);
+            ClothParams QP = CS.P;
+            QP.GX = (int)lroundf((float)base_GX * gs.grid_scale);
+            QP.GY = (int)lroundf((float)base_GY * gs.grid_scale);
+            if (QP.GX < 2)
+                QP.GX = 2;
+            if (QP.GY < 2)
+                QP.GY = 2;
+            QP.baseRadius = base_radius * gs.radius_scale;
+            // Mismo camino que el cambio de grilla en vivo: la malla nueva se
+            // arma por tramos en los próximos updates sin cortar la simulación
+            // (y con la misma grilla solo cambia el radio). El hilo de --simhz
+            // ya terminó su paso, así que CS se puede tocar.
+            if (cloth_resize(&CS, QP.GX, QP.GY, QP.baseRadius) < 0)
+                fprintf(stderr, "governor: la malla %dx%d no aplica; se mantiene la actual\n", QP.GX, QP.GY);
+            simhz = gs.simhz;
+#ifdef _OPENMP
+            omp_set_num_threads(gs.threads);
+            omp_threads = gs.threads;
+            // El pool de --taskgraph tiene sus propios hilos: se rehace con la
+            // cantidad nueva (solo en cambios de nivel, no por frame)
+            if (tgraph && tg_num_threads(tgraph) != gs.threads)
+            {
+                TaskGraph *ng = tg_create(gs.threads);
+                if (ng)
+                {
+                    tg_destroy(tgraph);
+                    tgraph = ng;
+                }
+            }
+#endif
+        }
+
         frame_count++;
+        frames_done++;
+        if (max_frames > 0 && frames_done >= max_frames)
+            running = 0;
         if (SDL_GetTicks() - fps_timer >= 1000)
         {
             fps = frame_count;
             frame_count = 0;
             fps_timer = SDL_GetTicks();
-            char title[256];
-            SDL_RendererInfo info;
-            SDL_GetRendererInfo(R, &info);
-            snprintf(title, sizeof(title),
-                     "Screensaver | Mode=cloth | %dx%d | FPS:%d | OMP:%s T=%d | Rndr:%s",
-                     W, H, fps, (omp_on ? "ON" : "OFF"), omp_threads, info.name ? info.name : "unknown");
-            SDL_SetWindowTitle(win, title);
+            pacer_window_stats(&pacer, &pstats);
+#ifdef _OPENMP
+            if (tg_frames_win > 0)
+                tg_idle_shown = tg_idle_win / (double)tg_frames_win;
+            tg_idle_win = 0.0;
+            tg_frames_win = 0;
+#endif
+            if (win)
+            {
+                char title[256];
+                char qual[48] = "";
+                if (governed)
+                    snprintf(qual, sizeof(qual), " Q%d (%.1f/%.1fms)", gov.level, gov.last_ms, gov.target_ms);
+                char res[48] = "";
+                if (scaled)
+                    snprintf(res, sizeof(res), " @%dx%d", rt_W, rt_H);
+                SDL_RendererInfo info;
+                SDL_GetRendererInfo(R, &info);
+                int len = snprintf(title, sizeof(title),
+                                   "Screensaver | Mode=cloth | %dx%d%s | FPS:%d%s | Jit:%.2fms max %.1f | OMP:%s T=%d | Rndr:%s",
+                                   W, H, res, fps, qual, pstats.std_ms, pstats.max_ms,
+                                   (omp_on ? "ON" : "OFF"), omp_threads, info.name ? info.name : "unknown");
+#ifdef _OPENMP
+                if (tgraph && len > 0 && (size_t)len < sizeof(title))
+                    len += snprintf(title + len, sizeof(title) - (size_t)len, " | TG idle:%.0f%%", tg_idle_shown);
+#endif
+                if (dist && len > 0 && (size_t)len < sizeof(title))
+                {
+                    DistStats ds;
+                    dist_stats(dist, &ds, NULL);
+                    len += snprintf(title + len, sizeof(title) - (size_t)len, " | DIST M=%d comp:%.2fms %.1fMB/f",
+                                    dist_workers, ds.composite_ms, ds.comm_bytes / 1048576.0);
+                }
+                if (shm && len > 0 && (size_t)len < sizeof(title))
+                {
+                    SimShmStats ss;
+                    simshm_stats(shm, &ss);
+                    if (shm_view)
+                        len += snprintf(title + len, sizeof(title) - (size_t)len, " | VIEW nuevos:%ld saltados:%ld",
+                                        ss.fresh, ss.skipped);
+                    else
+                        len += snprintf(title + len, sizeof(title) - (size_t)len, " | PUB seq:%llu", ss.published);
+                }
+                if (rec && len > 0 && (size_t)len < sizeof(title))
+                {
+                    RecStats st;
+                    rec_get_stats(rec, &st);
+                    snprintf(title + len, sizeof(title) - (size_t)len, " | REC q=%u drop=%llu",
+                             st.queued, st.dropped);
+                }
+                SDL_SetWindowTitle(win, title);
+            }
+            else
+            {
+                printf("frame %ld | FPS:%d | ", frames_done, fps);
+                if (governed)
+                    printf("Q%d %.1f/%.1fms T=%d | ", gov.level, gov.last_ms, gov.target_ms, gov.threads);
+                print_rec_stats(rec);
+            }
         }
+    }
 
-        if (fpscap > 0)
+    pacer_print_summary(&pacer);
+    energy_report(stdout);
+    if (simhz > 0.0)
+        printf("sim: %ld pasos para %ld frames (%.2f pasos/frame, %s), orden rehecho en %ld vistas\n", sim_steps,
+               frames_done, frames_done ? (double)sim_steps / (double)frames_done : 0.0,
+               sim ? "hilo propio" : "hilo de render", interp.rebins);
+    cloth_sim_stop(sim);
+    if (governed)
+        gov_print_summary(&gov);
+    if (grid_chg.phase == 2)
+        grid_report(&grid_chg, &CS);
+    if (grid_chg.count > 0)
+        printf("grid: %ld cambios en vivo, pico del frame del cambio sobre la mediana: medio %.2f ms, max %.2f ms\n",
+               grid_chg.count, grid_chg.spike_sum / (double)grid_chg.count, grid_chg.spike_max);
+    if (hidden_s > 0.0)
+        printf("ventana oculta: %.1f s sin simular\n", hidden_s);
+    cloth_interp_release(&interp);
+    perf_report(stdout);
+    perf_close();
+    energy_close();
+    if (dist)
+    {
+        DistStats tot;
+        dist_stats(dist, NULL, &tot);
+        if (tot.frames > 0)
         {
-            Uint32 frame_time = SDL_GetTicks() - now;
-            Uint32 delay = 1000u / (Uint32)fpscap;
-            if (frame_time < delay)
-                SDL_Delay(delay - frame_time);
+            const double nf = (double)tot.frames;
+            printf("dist: M=%d, %ld frames | sim+raster %.3f ms | composicion %.3f ms | frame %.3f ms | "
+                   "comunicacion %.2f MB/frame\n",
+                   dist_workers, tot.frames, tot.sim_ms / nf, tot.composite_ms / nf, tot.frame_ms / nf,
+                   tot.comm_bytes / nf / 1048576.0);
         }
+        dist_stop(dist);
     }
+    if (dist_tex)
+        SDL_DestroyTexture(dist_tex);
+    if (render_rt)
+        SDL_DestroyTexture(render_rt);
+    if (geocap)
+        geocap_close(geocap);
+    if (replay)
+        georeplay_close(replay);
+    if (shm)
+    {
+        SimShmStats ss;
+        simshm_stats(shm, &ss);
+        if (shm_view)
+            printf("simshm: %ld frames dibujados, %ld nuevos, %ld saltados, %ld descartados por sobrescritura\n",
+                   ss.shown, ss.fresh, ss.skipped, ss.torn);
+        else
+            printf("simshm: %llu frames publicados\n", ss.published);
+        // Antes de cloth_destroy: devuelve a CS sus buffers propios
+        simshm_close(shm, &CS);
+    }
+#ifdef _OPENMP
+    if (tgraph)
+    {
+        if (tg_frames > 0)
+            printf("taskgraph: %ld frames, tramo medio %.3f ms, ocio medio %.1f%% (T=%d)\n", tg_frames,
+                   tg_span_acc / (double)tg_frames, tg_idle_acc / (double)tg_frames, tg_num_threads(tgraph));
+        tg_destroy(tgraph);
+    }
+    if (tg_dump)
+        fclose(tg_dump);
+#endif
 
+    if (rec)
+    {
+        print_rec_stats(rec);
+        rec_close(rec);
+    }
+    metrics_close();
+    // Al final: ya no queda ningún hilo escribiendo tramos
+    trace_close();
     cloth_destroy(&CS);
 #ifdef _OPENMP
     cloth_draw_omp_release();
 #endif
     SDL_DestroyRenderer(R);
-    SDL_DestroyWindow(win);
+    if (win)
+        SDL_DestroyWindow(win);
+    if (frame_surf)
+        SDL_FreeSurface(frame_surf);
     SDL_Quit();
     return 0;
 }
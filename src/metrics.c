@@ -0,0 +1,315 @@
+// sockets Unix y poll necesitan las declaraciones POSIX
+#define _GNU_SOURCE
+#include "metrics.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <SDL2/SDL.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define METRICS_POSIX 1
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Últimos tiempos de frame (µs) para los percentiles; el render escribe su
+// slot y el servidor copia todo el anillo al responder (un slot a medio
+// reescribir solo cambia qué frame entra en la ventana).
+#define MET_RING 512
+#define MET_OUT 8192
+
+static const char *const g_stage_name[MET_NSTAGES] = {"update", "render", "record", "wait", "present"};
+
+static int g_enabled = 0;
+static atomic_uint g_ring[MET_RING];
+static atomic_ullong g_frames;
+static atomic_ullong g_frame_ns_sum;
+static atomic_ullong g_stage_last_ns[MET_NSTAGES];
+static atomic_ullong g_stage_ns_sum[MET_NSTAGES];
+static atomic_ullong g_spheres;
+static atomic_ullong g_visible; // UINT64_MAX = sin muestra
+static atomic_int g_threads;
+static atomic_ullong g_first_frame_ns; // 0 = todavía sin primer frame
+static _Atomic(const char *) g_backend;
+static Uint64 g_last_frame = 0; // solo hilo de render
+
+#ifdef METRICS_POSIX
+static int g_fd = -1;
+static char g_path[108];
+static SDL_Thread *g_thr = NULL;
+static atomic_int g_quit;
+
+static int cmp_u32(const void *a, const void *b)
+{
+    const unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+    return (x > y) - (x < y);
+}
+
+// Memoria residente según /proc (solo Linux); 0 si no se puede leer
+static unsigned long long resident_bytes(void)
+{
+#ifdef __linux__
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (!fp)
+        return 0;
+    unsigned long long size = 0, rss = 0;
+    const int ok = fscanf(fp, "%llu %llu", &size, &rss) == 2;
+    fclose(fp);
+    const long page = sysconf(_SC_PAGESIZE);
+    return ok && page > 0 ? rss * (unsigned long long)page : 0;
+#else
+    return 0;
+#endif
+}
+
+static size_t format_metrics(char *out, size_t cap)
+{
+    size_t len = 0;
+#define EMIT(...)                                                                                                  \
+    do                                                                                                             \
+    {                                                                                                              \
+        const int n_ = snprintf(out + len, cap - len, __VA_ARGS__);                                                \
+        if (n_ > 0)                                                                                                \
+            len = (len + (size_t)n_ < cap) ? len + (size_t)n_ : cap - 1;                                           \
+    } while (0)
+
+    const unsigned long long frames = atomic_load_explicit(&g_frames, memory_order_relaxed);
+    // Frames válidos en el anillo (el primero no tiene intervalo)
+    unsigned window[MET_RING];
+    size_t nw = frames > 1 ? (size_t)(frames - 1) : 0;
+    if (nw > MET_RING)
+        nw = MET_RING;
+    for (size_t k = 0; k < nw; ++k)
+        window[k] = atomic_load_explicit(&g_ring[k], memory_order_relaxed);
+    qsort(window, nw, sizeof(unsigned), cmp_u32);
+
+    EMIT("# HELP screensaver_frame_seconds Tiempo entre frames (ultimos %d frames).\n", MET_RING);
+    EMIT("# TYPE screensaver_frame_seconds summary\n");
+    static const double qs[] = {0.5, 0.9, 0.99};
+    for (int i = 0; i < 3 && nw > 0; ++i)
+    {
+        size_t idx = (size_t)(qs[i] * (double)(nw - 1) + 0.5);
+        EMIT("screensaver_frame_seconds{quantile=\"%g\"} %.6f\n", qs[i], (double)window[idx] * 1e-6);
+    }
+    EMIT("screensaver_frame_seconds_sum %.6f\n",
+         (double)atomic_load_explicit(&g_frame_ns_sum, memory_order_relaxed) * 1e-9);
+    EMIT("screensaver_frame_seconds_count %llu\n", frames > 0 ? frames - 1 : 0);
+
+    EMIT("# HELP screensaver_stage_seconds Duracion de cada etapa en el ultimo frame.\n");
+    EMIT("# TYPE screensaver_stage_seconds gauge\n");
+    for (int s = 0; s < MET_NSTAGES; ++s)
+        EMIT("screensaver_stage_seconds{stage=\"%s\"} %.6f\n", g_stage_name[s],
+             (double)atomic_load_explicit(&g_stage_last_ns[s], memory_order_relaxed) * 1e-9);
+    EMIT("# HELP screensaver_stage_seconds_total Tiempo acumulado por etapa.\n");
+    EMIT("# TYPE screensaver_stage_seconds_total counter\n");
+    for (int s = 0; s < MET_NSTAGES; ++s)
+        EMIT("screensaver_stage_seconds_total{stage=\"%s\"} %.6f\n", g_stage_name[s],
+             (double)atomic_load_explicit(&g_stage_ns_sum[s], memory_order_relaxed) * 1e-9);
+
+    EMIT("# HELP screensaver_spheres Esferas del estado dibujado.\n# TYPE screensaver_spheres gauge\n");
+    EMIT("screensaver_spheres %llu\n", atomic_load_explicit(&g_spheres, memory_order_relaxed));
+    const unsigned long long vis = atomic_load_explicit(&g_visible, memory_order_relaxed);
+    if (vis != UINT64_MAX)
+    {
+        EMIT("# HELP screensaver_spheres_visible Esferas que tocan el area visible (muestreado).\n");
+        EMIT("# TYPE screensaver_spheres_visible gauge\nscreensaver_spheres_visible %llu\n", vis);
+    }
+    EMIT("# HELP screensaver_threads Hilos del backend.\n# TYPE screensaver_threads gauge\n");
+    EMIT("screensaver_threads %d\n", atomic_load_explicit(&g_threads, memory_order_relaxed));
+    const char *backend = atomic_load_explicit(&g_backend, memory_order_relaxed);
+    EMIT("# HELP screensaver_backend_info Backend de dibujo en uso.\n# TYPE screensaver_backend_info gauge\n");
+    EMIT("screensaver_backend_info{backend=\"%s\"} 1\n", backend ? backend : "ninguno");
+    const unsigned long long first = atomic_load_explicit(&g_first_frame_ns, memory_order_relaxed);
+    if (first > 0)
+    {
+        EMIT("# HELP screensaver_first_frame_seconds Tiempo desde el arranque hasta el primer frame.\n");
+        EMIT("# TYPE screensaver_first_frame_seconds gauge\nscreensaver_first_frame_seconds %.6f\n",
+             (double)first * 1e-9);
+    }
+    const unsigned long long rss = resident_bytes();
+    if (rss > 0)
+    {
+        EMIT("# HELP screensaver_resident_bytes Memoria residente del proceso.\n");
+        EMIT("# TYPE screensaver_resident_bytes gauge\nscreensaver_resident_bytes %llu\n", rss);
+    }
+#undef EMIT
+    return len;
+}
+
+static void send_all(int fd, const char *p, size_t n)
+{
+    while (n > 0)
+    {
+        ssize_t k = send(fd, p, n, MSG_NOSIGNAL);
+        if (k < 0 && errno == EINTR)
+            continue;
+        if (k <= 0)
+            return;
+        p += k;
+        n -= (size_t)k;
+    }
+}
+
+static int server_main(void *arg)
+{
+    (void)arg;
+    trace_thread_name("metrics");
+    char *out = (char *)malloc(MET_OUT);
+    if (!out)
+        return 0;
+    while (!atomic_load(&g_quit))
+    {
+        struct pollfd pl = {g_fd, POLLIN, 0};
+        if (poll(&pl, 1, 200) <= 0)
+            continue;
+        const int c = accept(g_fd, NULL, NULL);
+        if (c < 0)
+            continue;
+        // Pedido opcional: un GET de HTTP recibe cabeceras; sin pedido, texto solo
+        char req[512];
+        ssize_t n = 0;
+        struct pollfd pc = {c, POLLIN, 0};
+        if (poll(&pc, 1, 100) > 0)
+            n = recv(c, req, sizeof(req), 0);
+        const size_t len = format_metrics(out, MET_OUT);
+        if (n >= 4 && memcmp(req, "GET ", 4) == 0)
+        {
+            char hdr[160];
+            const int h = snprintf(hdr, sizeof(hdr),
+                                   "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                   "Content-Length: %zu\r\n\r\n",
+                                   len);
+            if (h > 0)
+                send_all(c, hdr, (size_t)h);
+        }
+        send_all(c, out, len);
+        close(c);
+    }
+    free(out);
+    return 0;
+}
+#endif
+
+int metrics_open(const char *path)
+{
+#ifdef METRICS_POSIX
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path) || strlen(path) >= sizeof(g_path))
+    {
+        fprintf(stderr, "metrics: ruta demasiado larga: %s\n", path);
+        return 0;
+    }
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    g_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (g_fd < 0)
+    {
+        fprintf(stderr, "metrics: socket: %s\n", strerror(errno));
+        return 0;
+    }
+    // Un socket que quedó de una corrida anterior impediría el bind
+    unlink(path);
+    if (bind(g_fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(g_fd, 4) != 0)
+    {
+        fprintf(stderr, "metrics: %s: %s\n", path, strerror(errno));
+        close(g_fd);
+        g_fd = -1;
+        return 0;
+    }
+    snprintf(g_path, sizeof(g_path), "%s", path);
+    atomic_store(&g_visible, UINT64_MAX);
+    atomic_store(&g_quit, 0);
+    g_thr = SDL_CreateThread(server_main, "metrics", NULL);
+    if (!g_thr)
+    {
+        fprintf(stderr, "metrics: no se pudo crear el hilo servidor\n");
+        close(g_fd);
+        unlink(g_path);
+        g_fd = -1;
+        return 0;
+    }
+    g_enabled = 1;
+    printf("metrics: escuchando en %s\n", path);
+    return 1;
+#else
+    (void)path;
+    fprintf(stderr, "metrics: --metrics requiere sockets Unix\n");
+    return 0;
+#endif
+}
+
+int metrics_enabled(void) { return g_enabled; }
+
+void metrics_frame(void)
+{
+    if (!g_enabled)
+        return;
+    const Uint64 now = SDL_GetPerformanceCounter();
+    const unsigned long long k = atomic_load_explicit(&g_frames, memory_order_relaxed);
+    if (g_last_frame != 0)
+    {
+        const double ns = 1e9 * (double)(now - g_last_frame) / (double)SDL_GetPerformanceFrequency();
+        const double us = ns * 1e-3;
+        atomic_store_explicit(&g_ring[(k - 1) % MET_RING], us < 4e9 ? (unsigned)us : 4000000000u,
+                              memory_order_relaxed);
+        atomic_fetch_add_explicit(&g_frame_ns_sum, (unsigned long long)ns, memory_order_relaxed);
+    }
+    g_last_frame = now;
+    atomic_store_explicit(&g_frames, k + 1, memory_order_relaxed);
+}
+
+void metrics_stage(int stage, double ms)
+{
+    if (!g_enabled || stage < 0 || stage >= MET_NSTAGES)
+        return;
+    const unsigned long long ns = ms > 0.0 ? (unsigned long long)(ms * 1e6) : 0ull;
+    atomic_store_explicit(&g_stage_last_ns[stage], ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_stage_ns_sum[stage], ns, memory_order_relaxed);
+}
+
+void metrics_state(size_t spheres, int threads, const char *backend)
+{
+    if (!g_enabled)
+        return;
+    atomic_store_explicit(&g_spheres, (unsigned long long)spheres, memory_order_relaxed);
+    atomic_store_explicit(&g_threads, threads, memory_order_relaxed);
+    atomic_store_explicit(&g_backend, backend, memory_order_relaxed);
+}
+
+void metrics_visible(size_t visible)
+{
+    if (g_enabled)
+        atomic_store_explicit(&g_visible, (unsigned long long)visible, memory_order_relaxed);
+}
+
+void metrics_first_frame(double ms)
+{
+    if (g_enabled && ms > 0.0)
+        atomic_store_explicit(&g_first_frame_ns, (unsigned long long)(ms * 1e6), memory_order_relaxed);
+}
+
+void metrics_close(void)
+{
+    if (!g_enabled)
+        return;
+#ifdef METRICS_POSIX
+    atomic_store(&g_quit, 1);
+    SDL_WaitThread(g_thr, NULL);
+    g_thr = NULL;
+    close(g_fd);
+    g_fd = -1;
+    unlink(g_path);
+#endif
+    g_enabled = 0;
+}
@@ -0,0 +1,46 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Métricas en vivo en formato de texto de Prometheus sobre un socket Unix
+    // (--metrics PATH). El bucle de render solo hace stores atómicos relajados;
+    // un hilo servidor atiende cada conexión con una foto de los contadores,
+    // así que una lectura nunca frena un frame. Acepta un GET de HTTP (p. ej.
+    // curl --unix-socket) o una conexión sin pedido (socat), que recibe el
+    // texto sin cabeceras. Fuera de POSIX todo queda como no-op.
+
+    enum
+    {
+        MET_UPDATE = 0, // simulación (o lectura del frame en --view/--replay/--dist)
+        MET_RENDER,     // dibujo (incluye el escalado de --render-scale)
+        MET_RECORD,     // captura para --record
+        MET_WAIT,       // espera del pacer hasta el deadline
+        MET_PRESENT,    // SDL_RenderPresent
+        MET_NSTAGES
+    };
+
+    // Crea el socket (reemplaza uno viejo en la misma ruta) y el hilo servidor.
+    // Devuelve 1 si quedó escuchando; 0 con aviso si no.
+    int metrics_open(const char *path);
+    int metrics_enabled(void);
+    // Cierra un frame: el intervalo desde la llamada anterior es el tiempo de frame
+    void metrics_frame(void);
+    void metrics_stage(int stage, double ms);
+    // backend debe ser un literal (se guarda el puntero)
+    void metrics_state(size_t spheres, int threads, const char *backend);
+    // Esferas que tocan el área visible (muestreado; no se publica si nunca se llamó)
+    void metrics_visible(size_t visible);
+    // Tiempo desde el arranque del proceso hasta el primer frame presentado
+    void metrics_first_frame(double ms);
+    void metrics_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,121 @@
+#include "pacing.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Margen mínimo que se resuelve girando; SDL_Delay en Linux suele pasarse ~0.1-1 ms
+#define PACER_MIN_SPIN_S 0.0005
+#define PACER_EMA 0.1
+
+static inline double ticks_to_s(const FramePacer *P, Uint64 dt)
+{
+    return (double)dt / (double)P->freq;
+}
+
+void pacer_init(FramePacer *P, int fpscap)
+{
+    memset(P, 0, sizeof(*P));
+    P->freq = SDL_GetPerformanceFrequency();
+    P->t0 = SDL_GetPerformanceCounter();
+    // Periodo exacto en ticks: 144 Hz ya no se trunca a 6 ms
+    P->period = (fpscap > 0) ? (P->freq + (Uint64)fpscap / 2) / (Uint64)fpscap : 0;
+    P->deadline = P->t0 + P->period;
+    P->last_present = P->t0;
+    P->oversleep_ema = 0.001;
+    P->tot_min = 1e30;
+}
+
+double pacer_begin(FramePacer *P)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    P->frame_begin = now;
+    if (P->period)
+    {
+        // Si vamos más de un frame tarde, se resincroniza en vez de acumular
+        // una ráfaga de frames para "recuperar" el atraso.
+        if (now > P->deadline + P->period)
+        {
+            P->deadline = now + P->period;
+            P->missed++;
+        }
+        return ticks_to_s(P, P->deadline - P->t0);
+    }
+    return ticks_to_s(P, now - P->t0) + P->work_ema;
+}
+
+void pacer_wait(FramePacer *P)
+{
+    if (!P->period)
+        return;
+    const double spin = fmax(PACER_MIN_SPIN_S, 2.0 * P->oversleep_ema);
+    for (;;)
+    {
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now >= P->deadline)
+            break;
+        double remain = ticks_to_s(P, P->deadline - now);
+        if (remain > spin)
+        {
+            Uint32 ms = (Uint32)((remain - spin) * 1000.0);
+            if (ms == 0)
+                continue;
+            SDL_Delay(ms);
+            double slept = ticks_to_s(P, SDL_GetPerformanceCounter() - now);
+            double over = slept - (double)ms * 0.001;
+            if (over < 0.0)
+                over = 0.0;
+            P->oversleep_ema += PACER_EMA * (over - P->oversleep_ema);
+        }
+        // En el último tramo: giro activo sobre el contador
+    }
+    P->deadline += P->period;
+}
+
+void pacer_presented(FramePacer *P)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    double work = ticks_to_s(P, now - P->frame_begin);
+    P->work_ema += PACER_EMA * (work - P->work_ema);
+
+    double dt = ticks_to_s(P, now - P->last_present) * 1000.0;
+    P->last_present = now;
+    P->win_sum += dt;
+    P->win_sum2 += dt * dt;
+    if (dt > P->win_max)
+        P->win_max = dt;
+    P->win_n++;
+    P->tot_sum += dt;
+    P->tot_sum2 += dt * dt;
+    if (dt < P->tot_min)
+        P->tot_min = dt;
+    if (dt > P->tot_max)
+        P->tot_max = dt;
+    P->tot_n++;
+}
+
+static void stats_from(double sum, double sum2, unsigned long n, double *mean, double *sd)
+{
+    *mean = (n > 0) ? sum / (double)n : 0.0;
+    double var = (n > 1) ? (sum2 - (double)n * (*mean) * (*mean)) / (double)(n - 1) : 0.0;
+    *sd = (var > 0.0) ? sqrt(var) : 0.0;
+}
+
+void pacer_window_stats(FramePacer *P, PacerStats *out)
+{
+    stats_from(P->win_sum, P->win_sum2, P->win_n, &out->mean_ms, &out->std_ms);
+    out->max_ms = P->win_max;
+    out->frames = P->win_n;
+    P->win_sum = P->win_sum2 = P->win_max = 0.0;
+    P->win_n = 0;
+}
+
+void pacer_print_summary(const FramePacer *P)
+{
+    double mean, sd;
+    stats_from(P->tot_sum, P->tot_sum2, P->tot_n, &mean, &sd);
+    printf("pacing: frames=%lu intervalo medio=%.3f ms jitter(sd)=%.3f ms min=%.3f max=%.3f",
+           P->tot_n, mean, sd, P->tot_n ? P->tot_min : 0.0, P->tot_max);
+    if (P->period)
+        printf(" objetivo=%.3f ms resync=%lu", ticks_to_s(P, P->period) * 1000.0, P->missed);
+    printf("\n");
+}
@@ -0,0 +1,56 @@
+#ifndef PACING_H
+#define PACING_H
+
+#include <SDL2/SDL.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Ritmo de frames con SDL_GetPerformanceCounter (resolución sub-ms).
+    // El deadline se acumula (deadline += periodo) para que el error de cada
+    // espera no se propague; la espera es híbrida: SDL_Delay mientras falta
+    // mucho y giro activo en el último tramo.
+    typedef struct
+    {
+        Uint64 freq;       // ticks por segundo
+        Uint64 t0;         // origen de tiempo
+        Uint64 period;     // ticks por frame (0 = sin límite)
+        Uint64 deadline;   // instante objetivo de present del frame en curso
+        Uint64 frame_begin;
+        Uint64 last_present;
+        double work_ema;     // duración estimada begin→present (s)
+        double oversleep_ema; // exceso medio de SDL_Delay (s)
+
+        // Estadísticas del intervalo entre presents (ventana y total)
+        double win_sum, win_sum2, win_max;
+        unsigned long win_n;
+        double tot_sum, tot_sum2, tot_min, tot_max;
+        unsigned long tot_n, missed;
+    } FramePacer;
+
+    typedef struct
+    {
+        double mean_ms, std_ms, max_ms;
+        unsigned long frames;
+    } PacerStats;
+
+    void pacer_init(FramePacer *P, int fpscap);
+    // Inicio de frame. Devuelve el tiempo (s) en que se prevé presentar este
+    // frame: el deadline si hay límite, o ahora + trabajo estimado si no.
+    double pacer_begin(FramePacer *P);
+    // Espera (sleep + spin) hasta el deadline del frame y avanza el deadline.
+    void pacer_wait(FramePacer *P);
+    // Llamar justo después de SDL_RenderPresent: alimenta estadísticas y la
+    // estimación del tiempo de trabajo usada para predecir el present.
+    void pacer_presented(FramePacer *P);
+    // Estadísticas de la ventana actual (y la reinicia)
+    void pacer_window_stats(FramePacer *P, PacerStats *out);
+    // Resumen de toda la ejecución
+    void pacer_print_summary(const FramePacer *P);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
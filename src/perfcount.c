@@ -0,0 +1,236 @@
+// perf_event_open necesita la declaración de syscall()
+#define _GNU_SOURCE
+#include "perfcount.h"
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+enum
+{
+    EV_CYCLES = 0,
+    EV_INSTR,
+    EV_LLC_MISS,
+    EV_BR_MISS,
+    EV_COUNT
+};
+
+static const char *ev_names[EV_COUNT] = {"cycles", "instructions", "LLC-misses", "branch-misses"};
+static const char *st_names[PERF_ST_COUNT] = {"update", "bbox", "bin", "scatter", "render"};
+
+typedef struct
+{
+    double ev[EV_COUNT];
+    double seconds;
+    double spheres;
+    long calls;
+} StageAcc;
+
+static int g_enabled = 0;
+static int g_nthreads = 0;
+static int *g_fd = NULL;          // g_fd[tid * EV_COUNT + e]
+static int g_ev_ok[EV_COUNT];     // evento abierto en todos los hilos
+static double g_begin[EV_COUNT];  // snapshot al empezar la etapa activa
+static Uint64 g_begin_t = 0;
+static StageAcc g_acc[PERF_ST_COUNT];
+
+#ifdef __linux__
+static int open_event(int e)
+{
+    static const unsigned long long cfg[EV_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    struct perf_event_attr pa;
+    memset(&pa, 0, sizeof(pa));
+    pa.type = PERF_TYPE_HARDWARE;
+    pa.size = sizeof(pa);
+    pa.config = cfg[e];
+    pa.exclude_kernel = 1; // permitido con perf_event_paranoid <= 2
+    pa.exclude_hv = 1;
+    // Con multiplexado el valor se escala por enabled/running
+    pa.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // pid 0 + cpu -1: solo el hilo que abre, en cualquier CPU
+    return (int)syscall(SYS_perf_event_open, &pa, 0, -1, -1, 0);
+}
+
+static double read_event(int fd)
+{
+    unsigned long long v[3];
+    if (read(fd, v, sizeof(v)) != (ssize_t)sizeof(v) || v[2] == 0)
+        return 0.0;
+    return (double)v[0] * ((double)v[1] / (double)v[2]);
+}
+#endif
+
+int perf_open(void)
+{
+#ifdef __linux__
+#ifdef _OPENMP
+    g_nthreads = omp_get_max_threads();
+#else
+    g_nthreads = 1;
+#endif
+    g_fd = (int *)malloc((size_t)g_nthreads * EV_COUNT * sizeof(int));
+    if (!g_fd)
+        return 0;
+    for (int k = 0; k < g_nthreads * EV_COUNT; ++k)
+        g_fd[k] = -1;
+    int err = 0;
+
+    // Cada hilo del equipo abre sus contadores (perf los liga al hilo llamador)
+#ifdef _OPENMP
+#pragma omp parallel num_threads(g_nthreads)
+#endif
+    {
+#ifdef _OPENMP
+        const int tid = omp_get_thread_num();
+#else
+        const int tid = 0;
+#endif
+        for (int e = 0; e < EV_COUNT; ++e)
+        {
+            int fd = open_event(e);
+            g_fd[tid * EV_COUNT + e] = fd;
+            if (fd < 0)
+            {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+                err = errno;
+            }
+        }
+    }
+
+    int nok = 0;
+    for (int e = 0; e < EV_COUNT; ++e)
+    {
+        g_ev_ok[e] = 1;
+        for (int tid = 0; tid < g_nthreads; ++tid)
+            if (g_fd[tid * EV_COUNT + e] < 0)
+                g_ev_ok[e] = 0;
+        if (!g_ev_ok[e])
+        {
+            // Un evento a medias no sirve para sumar entre hilos
+            for (int tid = 0; tid < g_nthreads; ++tid)
+                if (g_fd[tid * EV_COUNT + e] >= 0)
+                {
+                    close(g_fd[tid * EV_COUNT + e]);
+                    g_fd[tid * EV_COUNT + e] = -1;
+                }
+            fprintf(stderr, "perf: %s no disponible\n", ev_names[e]);
+        }
+        else
+            nok++;
+    }
+    if (nok == 0)
+    {
+        fprintf(stderr, "perf: contadores de hardware no disponibles (%s); "
+                        "revise /proc/sys/kernel/perf_event_paranoid. --perfcounters desactivado\n",
+                strerror(err));
+        perf_close();
+        return 0;
+    }
+    memset(g_acc, 0, sizeof(g_acc));
+    g_enabled = 1;
+    printf("perf: %d/%d eventos en %d hilos\n", nok, EV_COUNT, g_nthreads);
+    return nok;
+#else
+    fprintf(stderr, "perf: --perfcounters solo está disponible en Linux\n");
+    return 0;
+#endif
+}
+
+int perf_enabled(void) { return g_enabled; }
+
+// Suma de cada evento sobre todos los hilos del equipo
+static void snapshot(double out[EV_COUNT])
+{
+    for (int e = 0; e < EV_COUNT; ++e)
+    {
+        out[e] = 0.0;
+#ifdef __linux__
+        if (!g_ev_ok[e])
+            continue;
+        for (int tid = 0; tid < g_nthreads; ++tid)
+            out[e] += read_event(g_fd[tid * EV_COUNT + e]);
+#endif
+    }
+}
+
+void perf_stage_begin(PerfStage s)
+{
+    (void)s;
+    if (!g_enabled)
+        return;
+    snapshot(g_begin);
+    g_begin_t = SDL_GetPerformanceCounter();
+}
+
+void perf_stage_end(PerfStage s, size_t spheres)
+{
+    if (!g_enabled)
+        return;
+    const Uint64 t1 = SDL_GetPerformanceCounter();
+    double now[EV_COUNT];
+    snapshot(now);
+    StageAcc *A = &g_acc[s];
+    for (int e = 0; e < EV_COUNT; ++e)
+        A->ev[e] += now[e] - g_begin[e];
+    A->seconds += (double)(t1 - g_begin_t) / (double)SDL_GetPerformanceFrequency();
+    A->spheres += (double)spheres;
+    A->calls++;
+}
+
+void perf_report(FILE *fp)
+{
+    if (!g_enabled)
+        return;
+    fprintf(fp, "perf: %-8s %8s %8s %6s %10s %10s %10s %10s\n", "etapa", "llamadas", "ms/llam",
+            "IPC", "ciclos/esf", "LLCm/esf", "bytes/esf", "brm/esf");
+    for (int s = 0; s < PERF_ST_COUNT; ++s)
+    {
+        const StageAcc *A = &g_acc[s];
+        if (A->calls == 0)
+            continue;
+        const double sph = (A->spheres > 0.0) ? A->spheres : 1.0;
+        char ipc[16] = "-", cyc[16] = "-", llc[16] = "-", bytes[16] = "-", brm[16] = "-";
+        if (g_ev_ok[EV_CYCLES] && g_ev_ok[EV_INSTR] && A->ev[EV_CYCLES] > 0.0)
+            snprintf(ipc, sizeof(ipc), "%.2f", A->ev[EV_INSTR] / A->ev[EV_CYCLES]);
+        if (g_ev_ok[EV_CYCLES])
+            snprintf(cyc, sizeof(cyc), "%.1f", A->ev[EV_CYCLES] / sph);
+        if (g_ev_ok[EV_LLC_MISS])
+        {
+            snprintf(llc, sizeof(llc), "%.4f", A->ev[EV_LLC_MISS] / sph);
+            // Tráfico aproximado con memoria: una línea de 64 B por miss de LLC
+            snprintf(bytes, sizeof(bytes), "%.2f", 64.0 * A->ev[EV_LLC_MISS] / sph);
+        }
+        if (g_ev_ok[EV_BR_MISS])
+            snprintf(brm, sizeof(brm), "%.4f", A->ev[EV_BR_MISS] / sph);
+        fprintf(fp, "perf: %-8s %8ld %8.3f %6s %10s %10s %10s %10s\n", st_names[s], A->calls,
+                1000.0 * A->seconds / (double)A->calls, ipc, cyc, llc, bytes, brm);
+    }
+}
+
+void perf_close(void)
+{
+#ifdef __linux__
+    if (g_fd)
+        for (int k = 0; k < g_nthreads * EV_COUNT; ++k)
+            if (g_fd[k] >= 0)
+                close(g_fd[k]);
+#endif
+    free(g_fd);
+    g_fd = NULL;
+    g_enabled = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Contadores de hardware por etapa (--perfcounters). Cada hilo OpenMP abre
+    // sus propios contadores con perf_event_open (ciclos, instrucciones, misses
+    // de LLC y de saltos); el hilo principal los lee todos en los bordes de cada
+    // etapa, cuando los hilos del equipo ya salieron de la región paralela.
+    // Fuera de Linux, o si el kernel no los expone, todo queda como no-op.
+    typedef enum
+    {
+        PERF_ST_UPDATE = 0, // proyección + radio/color + min/max de profundidad
+        PERF_ST_BBOX,       // reducción del bounding box
+        PERF_ST_BIN,        // índice de bin + histograma
+        PERF_ST_SCATTER,    // prefijo + scatter de order_idx
+        PERF_ST_RENDER,     // cloth_render_* (geometría + envío a SDL)
+        PERF_ST_COUNT
+    } PerfStage;
+
+    // Abre los contadores en cada hilo del equipo OpenMP. Devuelve cuántos
+    // eventos quedaron disponibles (0 = desactivado, ya con aviso impreso).
+    int perf_open(void);
+    int perf_enabled(void);
+    void perf_stage_begin(PerfStage s);
+    // 'spheres' = esferas procesadas en la etapa (para las métricas por esfera)
+    void perf_stage_end(PerfStage s, size_t spheres);
+    // Tabla por etapa: IPC, misses/esfera y bytes/esfera (misses de LLC x 64 B)
+    void perf_report(FILE *fp);
+    void perf_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,356 @@
+#include "record.h"
+#include "bufring.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Los frames se guardan en el anillo como RGBA8 (R,G,B,A en memoria)
+#define REC_BPP 4
+
+struct Recorder
+{
+    FILE *fp;            // NULL en modo imágenes sueltas
+    const char *pattern; // ruta con %d: un PPM por frame
+    // Partes de la ruta alrededor del %d (el nombre se arma sin printf sobre
+    // la ruta del usuario): prefijo, ancho/relleno con ceros y sufijo
+    int pat_pre, pat_width, pat_zero;
+    const char *pat_suf;
+    int W, H, fps;
+    int y4m;
+    int blocking; // 1 = esperar un slot libre en vez de descartar (render offline)
+    BufRing ring;
+    unsigned char *yuv; // buffer de conversión 4:2:0 (solo Y4M)
+    SDL_Thread *thr;
+    SDL_sem *sem;   // despierta al escritor sin bloquear al productor
+    SDL_sem *space; // el escritor avisa cada slot liberado (modo bloqueante)
+    atomic_int quit;
+    atomic_ullong written;
+    atomic_int io_error;
+    // Contadores del productor (solo hilo de render)
+    unsigned long long submitted, dropped;
+    unsigned queued_max;
+};
+
+static int ends_with(const char *s, const char *suf)
+{
+    size_t n = strlen(s), m = strlen(suf);
+    return n >= m && strcmp(s + n - m, suf) == 0;
+}
+
+static inline unsigned char clamp_u8(float v)
+{
+    if (v < 0.f)
+        return 0;
+    if (v > 255.f)
+        return 255;
+    return (unsigned char)(v + 0.5f);
+}
+
+// RGBA -> YUV 4:2:0 (BT.601 rango completo, "C420jpeg"). Cada iteración
+// procesa un par de filas para que el submuestreo de croma sea local.
+static void rgba_to_yuv420(const unsigned char *src, int W, int H, unsigned char *dst)
+{
+    unsigned char *Yp = dst;
+    unsigned char *Up = dst + (size_t)W * (size_t)H;
+    unsigned char *Vp = Up + (size_t)(W / 2) * (size_t)(H / 2);
+    const int pitch = W * REC_BPP;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int j = 0; j < H / 2; ++j)
+    {
+        const unsigned char *r0 = src + (size_t)(2 * j) * (size_t)pitch;
+        const unsigned char *r1 = r0 + pitch;
+        unsigned char *y0 = Yp + (size_t)(2 * j) * (size_t)W;
+        unsigned char *y1 = y0 + W;
+        for (int i = 0; i < W / 2; ++i)
+        {
+            float sr = 0.f, sg = 0.f, sb = 0.f;
+            const unsigned char *px[4] = {r0 + 8 * i, r0 + 8 * i + 4, r1 + 8 * i, r1 + 8 * i + 4};
+            unsigned char *py[4] = {y0 + 2 * i, y0 + 2 * i + 1, y1 + 2 * i, y1 + 2 * i + 1};
+            for (int k = 0; k < 4; ++k)
+            {
+                float r = px[k][0], g = px[k][1], b = px[k][2];
+                *py[k] = clamp_u8(0.299f * r + 0.587f * g + 0.114f * b);
+                sr += r;
+                sg += g;
+                sb += b;
+            }
+            sr *= 0.25f;
+            sg *= 0.25f;
+            sb *= 0.25f;
+            Up[(size_t)j * (size_t)(W / 2) + (size_t)i] = clamp_u8(-0.168736f * sr - 0.331264f * sg + 0.5f * sb + 128.f);
+            Vp[(size_t)j * (size_t)(W / 2) + (size_t)i] = clamp_u8(0.5f * sr - 0.418688f * sg - 0.081312f * sb + 128.f);
+        }
+    }
+}
+
+// Busca en la ruta exactamente una conversión %d, %Nd o %0Nd y guarda sus
+// partes. 1 = patrón válido, 0 = sin '%', -1 = cualquier otro uso de '%'.
+static int parse_pattern(Recorder *rc, const char *path)
+{
+    const char *pc = strchr(path, '%');
+    if (!pc)
+        return 0;
+    const char *q = pc + 1;
+    rc->pat_zero = (*q == '0');
+    int width = 0;
+    while (*q >= '0' && *q <= '9')
+    {
+        width = width * 10 + (*q - '0');
+        if (width > 20)
+            return -1;
+        ++q;
+    }
+    if (*q != 'd' || strchr(q + 1, '%'))
+        return -1;
+    rc->pat_pre = (int)(pc - path);
+    rc->pat_width = width;
+    rc->pat_suf = q + 1;
+    return 1;
+}
+
+// Un frame como PPM binario (RGB; se descarta el alpha)
+static int write_ppm(const Recorder *rc, const unsigned char *frame, unsigned long long index)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), rc->pat_zero ? "%.*s%0*llu%s" : "%.*s%*llu%s", rc->pat_pre, rc->pattern,
+             rc->pat_width, index, rc->pat_suf);
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        return 0;
+    fprintf(fp, "P6\n%d %d\n255\n", rc->W, rc->H);
+    const size_t w = (size_t)rc->W;
+    unsigned char *row = (unsigned char *)malloc(w * 3);
+    int ok = row != NULL;
+    for (size_t y = 0; ok && y < (size_t)rc->H; ++y)
+    {
+        const unsigned char *src = frame + y * w * REC_BPP;
+        for (size_t x = 0; x < w; ++x)
+        {
+            row[3 * x + 0] = src[REC_BPP * x + 0];
+            row[3 * x + 1] = src[REC_BPP * x + 1];
+            row[3 * x + 2] = src[REC_BPP * x + 2];
+        }
+        ok = fwrite(row, 1, w * 3, fp) == w * 3;
+    }
+    free(row);
+    return fclose(fp) == 0 && ok;
+}
+
+// Hilo escritor: drena el anillo y escribe a disco. Es el único que hace I/O.
+static int writer_main(void *arg)
+{
+    Recorder *rc = (Recorder *)arg;
+    const size_t yuv_bytes = (size_t)rc->W * (size_t)rc->H * 3 / 2;
+    trace_thread_name("rec-writer");
+    for (;;)
+    {
+        unsigned char *frame = bufring_peek(&rc->ring);
+        if (!frame)
+        {
+            if (atomic_load(&rc->quit))
+                break;
+            SDL_SemWaitTimeout(rc->sem, 50);
+            continue;
+        }
+        TraceSpan sp = trace_begin("rec-write");
+        size_t ok;
+        if (rc->pattern)
+            ok = (size_t)write_ppm(rc, frame, atomic_load(&rc->written));
+        else if (rc->y4m)
+        {
+            rgba_to_yuv420(frame, rc->W, rc->H, rc->yuv);
+            fputs("FRAME\n", rc->fp);
+            ok = fwrite(rc->yuv, 1, yuv_bytes, rc->fp) == yuv_bytes;
+        }
+        else
+        {
+            ok = fwrite(frame, 1, rc->ring.slot_bytes, rc->fp) == rc->ring.slot_bytes;
+        }
+        if (!ok)
+            atomic_store(&rc->io_error, 1);
+        bufring_release(&rc->ring);
+        atomic_fetch_add(&rc->written, 1ull);
+        SDL_SemPost(rc->space);
+        trace_end(sp);
+    }
+    return 0;
+}
+
+Recorder *rec_open(const char *path, int W, int H, int fps, int slots)
+{
+    if (!path || W <= 1 || H <= 1)
+        return NULL;
+    Recorder *rc = (Recorder *)calloc(1, sizeof(Recorder));
+    if (!rc)
+        return NULL;
+    const int pat = parse_pattern(rc, path);
+    if (pat < 0)
+    {
+        fprintf(stderr, "record: %s: solo se admite un %%d (o %%0Nd) en la ruta\n", path);
+        free(rc);
+        return NULL;
+    }
+    rc->pattern = pat ? path : NULL;
+    rc->y4m = !rc->pattern && ends_with(path, ".y4m");
+    // 4:2:0 exige dimensiones pares
+    rc->W = rc->y4m ? (W & ~1) : W;
+    rc->H = rc->y4m ? (H & ~1) : H;
+    rc->fps = (fps > 0) ? fps : 60;
+    if (slots < 2)
+        slots = 2;
+
+    rc->fp = rc->pattern ? NULL : fopen(path, "wb");
+    if (!rc->pattern && !rc->fp)
+    {
+        fprintf(stderr, "record: no se pudo abrir %s\n", path);
+        free(rc);
+        return NULL;
+    }
+    if (!bufring_init(&rc->ring, (unsigned)slots, (size_t)rc->W * (size_t)rc->H * REC_BPP))
+        goto fail;
+    if (rc->y4m)
+    {
+        rc->yuv = (unsigned char *)malloc((size_t)rc->W * (size_t)rc->H * 3 / 2);
+        if (!rc->yuv)
+            goto fail;
+        fprintf(rc->fp, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", rc->W, rc->H, rc->fps);
+    }
+    atomic_init(&rc->quit, 0);
+    atomic_init(&rc->written, 0ull);
+    atomic_init(&rc->io_error, 0);
+    rc->sem = SDL_CreateSemaphore(0);
+    rc->space = SDL_CreateSemaphore(0);
+    if (!rc->sem || !rc->space)
+        goto fail;
+    rc->thr = SDL_CreateThread(writer_main, "rec-writer", rc);
+    if (!rc->thr)
+        goto fail;
+
+    printf("record: %s %dx%d @%d fps (%s, %d buffers)\n", path, rc->W, rc->H, rc->fps,
+           rc->pattern ? "ppm por frame" : (rc->y4m ? "y4m 4:2:0" : "rgba raw"), slots);
+    return rc;
+
+fail:
+    fprintf(stderr, "record: sin memoria para %d buffers de %dx%d\n", slots, rc->W, rc->H);
+    if (rc->sem)
+        SDL_DestroySemaphore(rc->sem);
+    if (rc->space)
+        SDL_DestroySemaphore(rc->space);
+    bufring_free(&rc->ring);
+    free(rc->yuv);
+    if (rc->fp)
+        fclose(rc->fp);
+    free(rc);
+    return NULL;
+}
+
+// Reserva un slot libre; si no hay, cuenta el frame como descartado
+static unsigned char *acquire_slot(Recorder *rc, int W, int H)
+{
+    if (W < rc->W || H < rc->H)
+    {
+        rc->dropped++;
+        return NULL;
+    }
+    unsigned char *slot = bufring_acquire(&rc->ring);
+    // Offline no hay deadline: se espera a que el escritor libere un slot
+    while (!slot && rc->blocking && !atomic_load(&rc->io_error))
+    {
+        SDL_SemWaitTimeout(rc->space, 50);
+        slot = bufring_acquire(&rc->ring);
+    }
+    if (!slot)
+        rc->dropped++;
+    return slot;
+}
+
+static void publish_slot(Recorder *rc)
+{
+    bufring_publish(&rc->ring);
+    rc->submitted++;
+    unsigned q = bufring_size(&rc->ring);
+    if (q > rc->queued_max)
+        rc->queued_max = q;
+    SDL_SemPost(rc->sem);
+}
+
+int rec_capture(Recorder *rc, SDL_Renderer *R, int W, int H)
+{
+    if (!rc)
+        return 0;
+    unsigned char *slot = acquire_slot(rc, W, H);
+    if (!slot)
+        return 0;
+    SDL_Rect rect = {0, 0, rc->W, rc->H};
+    if (SDL_RenderReadPixels(R, &rect, SDL_PIXELFORMAT_RGBA32, slot, rc->W * REC_BPP) != 0)
+    {
+        rc->dropped++;
+        return 0;
+    }
+    publish_slot(rc);
+    return 1;
+}
+
+int rec_capture_pixels(Recorder *rc, const void *pixels, int pitch, int W, int H)
+{
+    if (!rc || !pixels)
+        return 0;
+    unsigned char *slot = acquire_slot(rc, W, H);
+    if (!slot)
+        return 0;
+    const size_t row = (size_t)rc->W * REC_BPP;
+    for (int y = 0; y < rc->H; ++y)
+        memcpy(slot + (size_t)y * row, (const unsigned char *)pixels + (size_t)y * (size_t)pitch, row);
+    publish_slot(rc);
+    return 1;
+}
+
+void rec_set_blocking(Recorder *rc, int on)
+{
+    if (rc)
+        rc->blocking = on;
+}
+
+void rec_get_stats(Recorder *rc, RecStats *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!rc)
+        return;
+    out->submitted = rc->submitted;
+    out->written = atomic_load(&rc->written);
+    out->dropped = rc->dropped;
+    out->queued = bufring_size(&rc->ring);
+    out->queued_max = rc->queued_max;
+}
+
+void rec_close(Recorder *rc)
+{
+    if (!rc)
+        return;
+    atomic_store(&rc->quit, 1);
+    SDL_SemPost(rc->sem);
+    SDL_WaitThread(rc->thr, NULL);
+
+    RecStats st;
+    rec_get_stats(rc, &st);
+    printf("record: escritos=%llu descartados=%llu cola_max=%u/%u%s\n",
+           st.written, st.dropped, st.queued_max, rc->ring.count,
+           atomic_load(&rc->io_error) ? " (ERROR de escritura)" : "");
+
+    if (rc->fp)
+        fclose(rc->fp);
+    SDL_DestroySemaphore(rc->sem);
+    SDL_DestroySemaphore(rc->space);
+    bufring_free(&rc->ring);
+    free(rc->yuv);
+    free(rc);
+}
@@ -0,0 +1,42 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <SDL2/SDL.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct Recorder Recorder;
+
+    typedef struct
+    {
+        unsigned long long submitted; // frames entregados al anillo
+        unsigned long long written;   // frames ya escritos a disco
+        unsigned long long dropped;   // frames descartados (anillo lleno o tamaño distinto)
+        unsigned queued;              // frames en cola ahora mismo
+        unsigned queued_max;          // pico de la cola
+    } RecStats;
+
+    // Abre el archivo de salida. Si termina en .y4m se escribe YUV4MPEG2 4:2:0
+    // (conversión RGB->YUV en el hilo escritor); si contiene un %d (p. ej.
+    // frame_%04d.ppm), un PPM por frame numerado desde 0; en otro caso, RGBA crudo.
+    // slots = número de buffers preasignados del anillo.
+    Recorder *rec_open(const char *path, int W, int H, int fps, int slots);
+    // Lee el frame actual del renderer hacia un buffer libre; nunca bloquea.
+    // Devuelve 0 si el frame se descartó.
+    int rec_capture(Recorder *rc, SDL_Renderer *R, int W, int H);
+    // Variante CPU: copia directamente un framebuffer RGBA (p. ej. la surface headless)
+    int rec_capture_pixels(Recorder *rc, const void *pixels, int pitch, int W, int H);
+    // on = 1: las capturas esperan un slot libre en vez de descartar el frame
+    // (render offline, donde importa no perder frames y no el deadline)
+    void rec_set_blocking(Recorder *rc, int on);
+    void rec_get_stats(Recorder *rc, RecStats *out);
+    // Drena la cola, cierra el archivo e imprime estadísticas
+    void rec_close(Recorder *rc);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
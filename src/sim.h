@@ -1,10 +1,61 @@
 #ifndef SIM_H
 #define SIM_H
 
+#include <stdint.h>
+#include <math.h>
+
+// Esfera lista para dibujar, compacta (8 bytes): el pipeline update → orden →
+// render recorre estos arreglos cada frame y a millones de esferas manda el
+// ancho de banda. La profundidad no va aquí: es una clave de 16 bits aparte
+// (ClothState.depth) que el bucket sort usa directamente.
 typedef struct
 {
-    float x, y, r;                // posición y radio (px)
-    unsigned char r8, g8, b8, a8; // color/alpha 8-bit
+    uint16_t x, y;   // posición en 1/DRAW_XY_FRAC px, desplazada DRAW_XY_BIAS px
+    uint16_t rgb565; // color
+    uint8_t rcode;   // radio en escala logarítmica (ver draw_radius_lut)
+    uint8_t a8;      // alpha
 } DrawItem;
 
+#define DRAW_XY_FRAC 4.0f    // subpíxeles por píxel
+#define DRAW_XY_BIAS 4096.0f // x, y representables: [-4096, 12288) px
+// Radio: r = 2^(rcode/DRAW_R_STEPS - 2), de 0.25 px a ~400 px en pasos de ~3%
+#define DRAW_R_STEPS 24.0f
+
+// Tabla de decodificación del radio (la llena cloth_init)
+extern float draw_radius_lut[256];
+void draw_codec_init(void);
+
+static inline uint16_t draw_enc_xy(float v)
+{
+    float q = (v + DRAW_XY_BIAS) * DRAW_XY_FRAC;
+    q = fminf(fmaxf(q, 0.f), 65535.f);
+    return (uint16_t)(q + 0.5f);
+}
+
+static inline float draw_dec_xy(uint16_t q)
+{
+    return (float)q * (1.0f / DRAW_XY_FRAC) - DRAW_XY_BIAS;
+}
+
+static inline uint8_t draw_enc_r(float r)
+{
+    float c = (log2f(fmaxf(r, 0.25f)) + 2.0f) * DRAW_R_STEPS;
+    c = fminf(c, 255.f);
+    return (uint8_t)(c + 0.5f);
+}
+
+static inline uint16_t draw_enc_rgb(unsigned char r, unsigned char g, unsigned char b)
+{
+    return (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+// 565 → 888 replicando los bits altos (0 y 255 se conservan)
+static inline void draw_dec_rgb(uint16_t c, unsigned char *r, unsigned char *g, unsigned char *b)
+{
+    const unsigned r5 = (c >> 11) & 31u, g6 = (c >> 5) & 63u, b5 = c & 31u;
+    *r = (unsigned char)((r5 << 3) | (r5 >> 2));
+    *g = (unsigned char)((g6 << 2) | (g6 >> 4));
+    *b = (unsigned char)((b5 << 3) | (b5 >> 2));
+}
+
 #endif
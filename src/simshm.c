@@ -0,0 +1,372 @@
+// shm_open/mmap/kill necesitan las extensiones POSIX
+#define _GNU_SOURCE
+#include "simshm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SIMSHM_POSIX 1
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#define SIMSHM_MAGIC 0x53484d31u // "SHM1"
+#define SIMSHM_SLOTS 4           // un visor tiene SLOTS-1 frames de margen antes de perder el suyo
+#define SIMSHM_STALE_MS 1000     // sin frames nuevos: se verifica que el productor siga vivo
+
+// Descriptor de un slot. seq = 2f-1 mientras se escribe el frame f, 2f cuando
+// está completo (seqlock: el visor compara seq antes y después de leer).
+typedef struct
+{
+    atomic_ullong seq;
+    long long n;
+    int W, H;
+    float tx, ty;
+} ShmSlot;
+
+// Cabecera al inicio del segmento; los datos de cada slot van después:
+// DrawItem[cap] | int order_idx[cap], alineados a 64 bytes.
+typedef struct
+{
+    atomic_uint magic; // se escribe último: el segmento está listo
+    unsigned item_size;
+    int GX, GY;       // malla del productor
+    float baseRadius; // radio base ya resuelto (tamaño del sprite)
+    long long cap;
+    long long pid;
+    unsigned long long slot_bytes, data_off;
+    atomic_int closed;
+    atomic_ullong latest; // último frame completo (0 = ninguno)
+    ShmSlot slot[SIMSHM_SLOTS];
+} ShmHeader;
+
+struct SimShm
+{
+    char name[128];
+    int producer;
+    unsigned char *base;
+    size_t bytes;
+    ShmHeader *hdr;
+
+    // Productor: buffers propios de S, restituidos al cerrar
+    DrawItem *own_draw;
+    int *own_order;
+    size_t own_cap;
+    int swapped;
+    unsigned long long frame; // frame en escritura
+
+    // Visor: slot en uso y su número de secuencia
+    int cur;
+    unsigned long long cur_seq, last_seen;
+    Uint32 stale_since;
+
+    SimShmStats st;
+};
+
+static size_t align64(size_t n)
+{
+    return (n + 63) & ~(size_t)63;
+}
+
+static DrawItem *slot_draw(const SimShm *Q, int k)
+{
+    return (DrawItem *)(Q->base + (size_t)(Q->hdr->data_off + (unsigned long long)k * Q->hdr->slot_bytes));
+}
+
+static int *slot_order(const SimShm *Q, int k)
+{
+    return (int *)((unsigned char *)slot_draw(Q, k) + align64((size_t)Q->hdr->cap * sizeof(DrawItem)));
+}
+
+// Los nombres POSIX de shm empiezan con '/'
+static void shm_name(char *dst, size_t n, const char *name)
+{
+    snprintf(dst, n, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+SimShm *simshm_create(const char *name, const ClothState *S)
+{
+#ifdef SIMSHM_POSIX
+    const size_t cap = S->N;
+    if (cap == 0)
+        return NULL;
+    SimShm *Q = (SimShm *)calloc(1, sizeof(SimShm));
+    if (!Q)
+        return NULL;
+    Q->producer = 1;
+    shm_name(Q->name, sizeof(Q->name), name);
+
+    const size_t hdr_bytes = align64(sizeof(ShmHeader));
+    const size_t slot_bytes = align64(cap * sizeof(DrawItem)) + align64(cap * sizeof(int));
+    Q->bytes = hdr_bytes + SIMSHM_SLOTS * slot_bytes;
+
+    // Un segmento viejo (productor caído) se reemplaza: sus visores verán
+    // que el pid ya no existe y terminan.
+    shm_unlink(Q->name);
+    int fd = shm_open(Q->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)Q->bytes) != 0)
+    {
+        fprintf(stderr, "simshm: no se pudo crear %s: %s\n", Q->name, strerror(errno));
+        if (fd >= 0)
+        {
+            close(fd);
+            shm_unlink(Q->name);
+        }
+        free(Q);
+        return NULL;
+    }
+    void *mem = mmap(NULL, Q->bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        fprintf(stderr, "simshm: mmap de %.1f MB falló\n", (double)Q->bytes / 1048576.0);
+        shm_unlink(Q->name);
+        free(Q);
+        return NULL;
+    }
+    Q->base = (unsigned char *)mem;
+    Q->hdr = (ShmHeader *)mem;
+    ShmHeader *h = Q->hdr;
+    h->item_size = (unsigned)sizeof(DrawItem);
+    h->GX = S->P.GX;
+    h->GY = S->P.GY;
+    h->baseRadius = S->P.baseRadius;
+    h->cap = (long long)cap;
+    h->pid = (long long)getpid();
+    h->slot_bytes = slot_bytes;
+    h->data_off = hdr_bytes;
+    atomic_init(&h->closed, 0);
+    atomic_init(&h->latest, 0);
+    for (int k = 0; k < SIMSHM_SLOTS; ++k)
+        atomic_init(&h->slot[k].seq, 0);
+    atomic_store_explicit(&h->magic, SIMSHM_MAGIC, memory_order_release);
+    printf("simshm: publicando en %s (%d slots x %zu esferas, %.1f MB)\n", Q->name, SIMSHM_SLOTS, cap,
+           (double)Q->bytes / 1048576.0);
+    return Q;
+#else
+    (void)name;
+    (void)S;
+    fprintf(stderr, "simshm: --publish requiere un sistema POSIX (shm_open)\n");
+    return NULL;
+#endif
+}
+
+int simshm_begin(SimShm *Q, ClothState *S)
+{
+    if (!Q || !Q->producer || S->N > (size_t)Q->hdr->cap)
+        return 0;
+    if (!Q->swapped)
+    {
+        Q->own_draw = S->draw;
+        Q->own_order = S->order_idx;
+        Q->own_cap = S->order_cap;
+        Q->swapped = 1;
+    }
+    Q->frame = Q->st.published + 1;
+    const int k = (int)(Q->frame % SIMSHM_SLOTS);
+    ShmSlot *sl = &Q->hdr->slot[k];
+    atomic_store_explicit(&sl->seq, 2 * Q->frame - 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    // cloth_update escribe directo en el slot; order_cap = cap evita que
+    // ensure_capacity_order intente realloc sobre memoria compartida
+    S->draw = slot_draw(Q, k);
+    S->order_idx = slot_order(Q, k);
+    S->order_cap = (size_t)Q->hdr->cap;
+    return 1;
+}
+
+void simshm_commit(SimShm *Q, const ClothState *S, int W, int H)
+{
+    if (!Q || !Q->producer || Q->frame != Q->st.published + 1)
+        return;
+    const int k = (int)(Q->frame % SIMSHM_SLOTS);
+    ShmSlot *sl = &Q->hdr->slot[k];
+    sl->n = (long long)S->N;
+    sl->W = W;
+    sl->H = H;
+    sl->tx = S->tx;
+    sl->ty = S->ty;
+    atomic_store_explicit(&sl->seq, 2 * Q->frame, memory_order_release);
+    atomic_store_explicit(&Q->hdr->latest, Q->frame, memory_order_release);
+    Q->st.published = Q->frame;
+}
+
+SimShm *simshm_open(const char *name)
+{
+#ifdef SIMSHM_POSIX
+    SimShm *Q = (SimShm *)calloc(1, sizeof(SimShm));
+    if (!Q)
+        return NULL;
+    shm_name(Q->name, sizeof(Q->name), name);
+    int fd = shm_open(Q->name, O_RDONLY, 0);
+    struct stat sb;
+    if (fd < 0 || fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(ShmHeader))
+    {
+        fprintf(stderr, "simshm: no hay productor en %s (%s)\n", Q->name, fd < 0 ? strerror(errno) : "segmento corto");
+        if (fd >= 0)
+            close(fd);
+        free(Q);
+        return NULL;
+    }
+    Q->bytes = (size_t)sb.st_size;
+    void *mem = mmap(NULL, Q->bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        fprintf(stderr, "simshm: mmap de %s falló: %s\n", Q->name, strerror(errno));
+        free(Q);
+        return NULL;
+    }
+    Q->base = (unsigned char *)mem;
+    Q->hdr = (ShmHeader *)mem;
+    const ShmHeader *h = Q->hdr;
+    if (atomic_load_explicit(&Q->hdr->magic, memory_order_acquire) != SIMSHM_MAGIC ||
+        h->item_size != sizeof(DrawItem) || h->cap <= 0 ||
+        h->data_off + SIMSHM_SLOTS * h->slot_bytes > Q->bytes)
+    {
+        fprintf(stderr, "simshm: %s no es un anillo compatible\n", Q->name);
+        munmap(mem, Q->bytes);
+        free(Q);
+        return NULL;
+    }
+    Q->cur = -1;
+    Q->stale_since = SDL_GetTicks();
+    printf("simshm: visor de %s (%lld esferas, productor pid %lld)\n", Q->name, h->cap, h->pid);
+    return Q;
+#else
+    (void)name;
+    fprintf(stderr, "simshm: --view requiere un sistema POSIX (shm_open)\n");
+    return NULL;
+#endif
+}
+
+void simshm_params(const SimShm *Q, ClothParams *P)
+{
+    P->GX = Q->hdr->GX;
+    P->GY = Q->hdr->GY;
+    P->baseRadius = Q->hdr->baseRadius;
+}
+
+// Productor vivo: el segmento no se cerró y su proceso existe
+static int producer_alive(const SimShm *Q)
+{
+    if (atomic_load_explicit(&Q->hdr->closed, memory_order_acquire))
+        return 0;
+#ifdef SIMSHM_POSIX
+    if (kill((pid_t)Q->hdr->pid, 0) != 0 && errno == ESRCH)
+        return 0;
+#endif
+    return 1;
+}
+
+int simshm_acquire(SimShm *Q, const ClothState *base, ClothState *view, int *W, int *H)
+{
+    ShmHeader *h = Q->hdr;
+    if (atomic_load_explicit(&h->closed, memory_order_acquire))
+        return -1;
+    // El último frame puede reescribirse entre leer 'latest' y su slot: se
+    // reintenta con el nuevo 'latest' (el productor nunca espera).
+    for (int tries = 0; tries < SIMSHM_SLOTS; ++tries)
+    {
+        const unsigned long long f = atomic_load_explicit(&h->latest, memory_order_acquire);
+        if (f == 0)
+            break;
+        const int k = (int)(f % SIMSHM_SLOTS);
+        const ShmSlot *sl = &h->slot[k];
+        const unsigned long long s1 = atomic_load_explicit(&sl->seq, memory_order_acquire);
+        if (s1 != 2 * f)
+            continue;
+        const long long n = sl->n;
+        const int w = sl->W, hh = sl->H;
+        const float tx = sl->tx, ty = sl->ty;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&sl->seq, memory_order_relaxed) != s1 || n < 0 || n > h->cap)
+            continue;
+
+        if (f != Q->last_seen)
+        {
+            if (Q->last_seen && f > Q->last_seen + 1)
+                Q->st.skipped += (long)(f - Q->last_seen - 1);
+            Q->st.fresh++;
+            Q->last_seen = f;
+            Q->stale_since = SDL_GetTicks();
+        }
+        else if (SDL_GetTicks() - Q->stale_since > SIMSHM_STALE_MS)
+        {
+            if (!producer_alive(Q))
+                return -1;
+            Q->stale_since = SDL_GetTicks();
+        }
+        Q->st.shown++;
+        Q->cur = k;
+        Q->cur_seq = s1;
+
+        *view = *base;
+        view->sorted = NULL;
+        view->bin_start = NULL;
+        view->depth = NULL; // el anillo no transporta profundidad
+        view->draw = slot_draw(Q, k);
+        view->order_idx = slot_order(Q, k);
+        view->order_cap = (size_t)n;
+        view->N = (size_t)n;
+        view->tx = tx;
+        view->ty = ty;
+        *W = w;
+        *H = hh;
+        return 1;
+    }
+    if (SDL_GetTicks() - Q->stale_since > SIMSHM_STALE_MS)
+    {
+        if (!producer_alive(Q))
+            return -1;
+        Q->stale_since = SDL_GetTicks();
+    }
+    return 0;
+}
+
+int simshm_release(SimShm *Q)
+{
+    if (Q->cur < 0)
+        return 1;
+    atomic_thread_fence(memory_order_acquire);
+    const unsigned long long s2 = atomic_load_explicit(&Q->hdr->slot[Q->cur].seq, memory_order_relaxed);
+    Q->cur = -1;
+    if (s2 == Q->cur_seq)
+        return 1;
+    Q->st.torn++;
+    return 0;
+}
+
+void simshm_stats(const SimShm *Q, SimShmStats *st)
+{
+    *st = Q->st;
+}
+
+void simshm_close(SimShm *Q, ClothState *S)
+{
+    if (!Q)
+        return;
+    if (Q->producer)
+    {
+        if (S && Q->swapped)
+        {
+            S->draw = Q->own_draw;
+            S->order_idx = Q->own_order;
+            S->order_cap = Q->own_cap;
+        }
+        atomic_store_explicit(&Q->hdr->closed, 1, memory_order_release);
+    }
+#ifdef SIMSHM_POSIX
+    munmap(Q->base, Q->bytes);
+    if (Q->producer)
+        shm_unlink(Q->name);
+#endif
+    free(Q);
+}
@@ -0,0 +1,59 @@
+#ifndef SIMSHM_H
+#define SIMSHM_H
+
+#include <SDL2/SDL.h>
+#include "cloth.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Servicio de simulación en memoria compartida POSIX (--publish / --view).
+    // Un productor corre cloth_update una sola vez por frame escribiendo
+    // draw/order_idx directamente en un anillo de slots compartido; cualquier
+    // número de visores mapea el anillo en solo lectura y dibuja el último
+    // frame completo sin copiarlo. Cada slot lleva un número de secuencia
+    // (impar = escribiéndose): el productor nunca espera a los visores y un
+    // visor atrasado salta frames o descarta el que se sobrescribió mientras
+    // lo dibujaba.
+    typedef struct SimShm SimShm;
+
+    typedef struct
+    {
+        unsigned long long published; // productor: frames publicados
+        long shown;                   // visor: frames dibujados
+        long fresh;                   // visor: de ellos, frames nuevos
+        long skipped;                 // visor: frames publicados que nunca vio
+        long torn;                    // visor: sobrescritos mientras se dibujaban
+    } SimShmStats;
+
+    // Productor: crea (o recrea) el segmento 'name' para las S->N esferas de
+    // un estado ya inicializado
+    SimShm *simshm_create(const char *name, const ClothState *S);
+    // Antes de cloth_update: apunta S->draw/S->order_idx al próximo slot
+    int simshm_begin(SimShm *Q, ClothState *S);
+    // Después de cloth_update: publica el slot (W x H = espacio de píxeles)
+    void simshm_commit(SimShm *Q, const ClothState *S, int W, int H);
+
+    // Visor: mapea en solo lectura un segmento existente
+    SimShm *simshm_open(const char *name);
+    // Malla y radio base del productor (para inicializar el estado local:
+    // mismas dimensiones y mismo sprite)
+    void simshm_params(const SimShm *Q, ClothParams *P);
+    // Arma en *view (copia de base con draw/order_idx dentro del mapeo) el
+    // último frame completo y el tamaño W x H en que se proyectó. Devuelve 0
+    // si todavía no hay frames y -1 si el productor terminó.
+    int simshm_acquire(SimShm *Q, const ClothState *base, ClothState *view, int *W, int *H);
+    // Tras dibujar *view: 1 si el slot siguió intacto, 0 si el productor lo
+    // reescribió durante el dibujo (hay que descartar lo dibujado)
+    int simshm_release(SimShm *Q);
+
+    void simshm_stats(const SimShm *Q, SimShmStats *st);
+    // Productor: devuelve a S sus buffers propios y borra el segmento
+    void simshm_close(SimShm *Q, ClothState *S);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,550 @@
+#include "taskgraph.h"
+#include "trace.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    const char *name;
+    TaskFn fn;
+    void *ctx;
+    long a, b;
+    int flags;
+    int npred;
+    atomic_int pending; // predecesoras sin terminar
+    int succ0, nsucc;   // sucesoras en G->succ[succ0 .. succ0+nsucc)
+    int worker;
+    Uint64 t0, t1;
+} Task;
+
+// Deque de Chase-Lev sin locks: el dueño empuja/saca por abajo y los
+// ladrones toman por arriba con un CAS. Cada tarea se encola una sola vez por
+// tg_run, así que con capacidad para todas las tareas no hace falta anillo:
+// los índices se reinician entre corridas, cuando ningún hilo los toca.
+typedef struct
+{
+    atomic_int *ids;
+    atomic_long top, bottom;
+} Deque;
+
+// Cola de las tareas TG_MAIN: varios productores (quien termina la
+// predecesora) y un solo consumidor (el hilo principal). Cada productor
+// reserva un casillero con fetch_add y lo publica con id + 1; 0 es vacío.
+typedef struct
+{
+    atomic_int *slot;
+    atomic_int tail;
+    int head;
+} MainQueue;
+
+// Estacionamiento de un hilo sin trabajo: marca 'idle' y duerme en su
+// semáforo; quien encola trabajo lo despierta solo si la marca estaba puesta
+// (atomic_exchange), así cada SDL_SemPost tiene exactamente un SDL_SemWait.
+// El mismo semáforo arranca la corrida de los trabajadores.
+typedef struct
+{
+    atomic_int idle;
+    SDL_sem *sem;
+} Parker;
+
+struct TaskGraph
+{
+    int nthreads;
+    SDL_Thread **thr;
+    Parker *park; // uno por hilo (0 = el que llama a tg_run)
+    SDL_sem *done; // lo postea el último trabajador en salir de la corrida
+    atomic_int quit;
+    atomic_int remaining; // tareas sin terminar en la corrida actual
+    atomic_int in_run;    // trabajadores que aún no salieron de la corrida
+
+    Task *tasks;
+    int ntasks, cap;
+    int *edge_from, *edge_to;
+    int nedges, ecap;
+    int *succ;
+
+    Deque *dq;       // uno por hilo
+    MainQueue mainq; // tareas TG_MAIN
+    int dq_cap;
+
+    Uint64 run_t0, run_t1;
+};
+
+static void dq_push(Deque *d, int id)
+{
+    const long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    atomic_store_explicit(&d->ids[b], id, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+static int dq_pop(Deque *d)
+{
+    const long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    int id = -1;
+    if (t <= b)
+    {
+        id = atomic_load_explicit(&d->ids[b], memory_order_relaxed);
+        if (t == b)
+        {
+            // Último elemento: se lo disputa con los ladrones
+            if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst,
+                                                         memory_order_relaxed))
+                id = -1;
+            atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        }
+    }
+    else
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return id;
+}
+
+static int dq_steal(Deque *d)
+{
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    const long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b)
+        return -1;
+    const int id = atomic_load_explicit(&d->ids[t], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst,
+                                                 memory_order_relaxed))
+        return -1; // otro ladrón (o el dueño) ganó
+    return id;
+}
+
+static int dq_nonempty(Deque *d)
+{
+    return atomic_load_explicit(&d->bottom, memory_order_relaxed) >
+           atomic_load_explicit(&d->top, memory_order_relaxed);
+}
+
+static void mq_push(MainQueue *q, int id)
+{
+    const int i = atomic_fetch_add_explicit(&q->tail, 1, memory_order_relaxed);
+    atomic_store_explicit(&q->slot[i], id + 1, memory_order_release);
+}
+
+static int mq_pop(MainQueue *q)
+{
+    if (q->head >= atomic_load_explicit(&q->tail, memory_order_relaxed))
+        return -1;
+    const int v = atomic_load_explicit(&q->slot[q->head], memory_order_acquire);
+    if (v == 0)
+        return -1; // reservado pero aún sin publicar
+    q->head++;
+    return v - 1;
+}
+
+static int unpark(TaskGraph *G, int w)
+{
+    if (!atomic_exchange_explicit(&G->park[w].idle, 0, memory_order_acq_rel))
+        return 0;
+    SDL_SemPost(G->park[w].sem);
+    return 1;
+}
+
+// Despierta hilos dormidos para 'nlocal' tareas nuevas en el deque de 'wid'
+// y al principal si hay TG_MAIN. Un trabajador se queda con una de las suyas;
+// el principal no, porque primero atiende los envíos.
+static void notify(TaskGraph *G, int wid, int nlocal, int nmain)
+{
+    atomic_thread_fence(memory_order_seq_cst); // las tareas se ven antes que 'idle'
+    if (nmain > 0 && wid != 0)
+        unpark(G, 0);
+    const int keep = (wid == 0) ? 0 : 1;
+    for (int k = 1; nlocal > keep && k < G->nthreads; ++k)
+        nlocal -= unpark(G, (wid + k) % G->nthreads);
+}
+
+static void notify_all(TaskGraph *G)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    for (int w = 0; w < G->nthreads; ++w)
+        unpark(G, w);
+}
+
+static int work_visible(TaskGraph *G, int wid)
+{
+    if (atomic_load_explicit(&G->remaining, memory_order_acquire) == 0)
+        return 1;
+    if (wid == 0 && G->mainq.head < atomic_load_explicit(&G->mainq.tail, memory_order_relaxed))
+        return 1;
+    for (int w = 0; w < G->nthreads; ++w)
+        if (dq_nonempty(&G->dq[w]))
+            return 1;
+    return 0;
+}
+
+// Sin trabajo listo: se marca ocioso, vuelve a mirar (el que encola pudo no
+// ver la marca) y recién entonces duerme hasta que lo despierten.
+static void park_idle(TaskGraph *G, int wid)
+{
+    Parker *P = &G->park[wid];
+    atomic_store_explicit(&P->idle, 1, memory_order_seq_cst);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (work_visible(G, wid))
+    {
+        // Si alguien ya tomó la marca, también posteó: se consume ese post
+        if (!atomic_exchange_explicit(&P->idle, 0, memory_order_acq_rel))
+            SDL_SemWait(P->sem);
+        return;
+    }
+    SDL_SemWait(P->sem);
+}
+
+static void run_task(TaskGraph *G, int id, int wid)
+{
+    Task *T = &G->tasks[id];
+    T->worker = wid;
+    TraceSpan sp = trace_begin(T->name);
+    T->t0 = SDL_GetPerformanceCounter();
+    T->fn(T->ctx, T->a, T->b);
+    T->t1 = SDL_GetPerformanceCounter();
+    trace_end_arg(sp, T->a);
+
+    // Las sucesoras que quedan listas se encolan aquí (localidad de caché)
+    int nlocal = 0, nmain = 0;
+    for (int e = 0; e < T->nsucc; ++e)
+    {
+        int s = G->succ[T->succ0 + e];
+        if (atomic_fetch_sub_explicit(&G->tasks[s].pending, 1, memory_order_acq_rel) == 1)
+        {
+            if (G->tasks[s].flags & TG_MAIN)
+            {
+                mq_push(&G->mainq, s);
+                nmain++;
+            }
+            else
+            {
+                dq_push(&G->dq[wid], s);
+                nlocal++;
+            }
+        }
+    }
+    if (nlocal > 0 || nmain > 0)
+        notify(G, wid, nlocal, nmain);
+    // La corrida termina al completarse la última tarea, no cuando los hilos
+    // salen del bucle: quien la completa despierta a todos para que salgan.
+    if (atomic_fetch_sub_explicit(&G->remaining, 1, memory_order_acq_rel) == 1)
+        notify_all(G);
+}
+
+// Intentos sin trabajo antes de estacionarse (cubre huecos cortos entre tareas)
+#define TG_SPIN 64
+
+static void worker_loop(TaskGraph *G, int wid)
+{
+    int misses = 0;
+    while (atomic_load_explicit(&G->remaining, memory_order_acquire) > 0)
+    {
+        int id = -1;
+        if (wid == 0)
+            id = mq_pop(&G->mainq);
+        if (id < 0)
+            id = dq_pop(&G->dq[wid]);
+        for (int k = 1; id < 0 && k < G->nthreads; ++k)
+            id = dq_steal(&G->dq[(wid + k) % G->nthreads]);
+        if (id < 0)
+        {
+            if (++misses > TG_SPIN)
+            {
+                park_idle(G, wid);
+                misses = 0;
+            }
+            continue;
+        }
+        misses = 0;
+        run_task(G, id, wid);
+    }
+}
+
+typedef struct
+{
+    TaskGraph *G;
+    int wid;
+} WorkerArg;
+
+static int worker_main(void *p)
+{
+    WorkerArg *wa = (WorkerArg *)p;
+    TaskGraph *G = wa->G;
+    const int wid = wa->wid;
+    free(wa);
+    trace_thread_name("tg-worker");
+    for (;;)
+    {
+        // Entre corridas nadie postea este semáforo salvo tg_run/tg_destroy
+        SDL_SemWait(G->park[wid].sem);
+        if (atomic_load(&G->quit))
+            break;
+        worker_loop(G, wid);
+        if (atomic_fetch_sub_explicit(&G->in_run, 1, memory_order_acq_rel) == 1)
+            SDL_SemPost(G->done);
+    }
+    return 0;
+}
+
+TaskGraph *tg_create(int nthreads)
+{
+    if (nthreads < 1)
+        nthreads = 1;
+    TaskGraph *G = (TaskGraph *)calloc(1, sizeof(TaskGraph));
+    if (!G)
+        return NULL;
+    G->nthreads = nthreads;
+    atomic_init(&G->quit, 0);
+    atomic_init(&G->remaining, 0);
+    atomic_init(&G->in_run, 0);
+    G->dq = (Deque *)calloc((size_t)nthreads, sizeof(Deque));
+    G->thr = (SDL_Thread **)calloc((size_t)nthreads, sizeof(SDL_Thread *));
+    G->park = (Parker *)calloc((size_t)nthreads, sizeof(Parker));
+    G->done = SDL_CreateSemaphore(0);
+    if (!G->dq || !G->thr || !G->park || !G->done)
+    {
+        tg_destroy(G);
+        return NULL;
+    }
+    for (int w = 0; w < nthreads; ++w)
+    {
+        atomic_init(&G->dq[w].top, 0);
+        atomic_init(&G->dq[w].bottom, 0);
+        atomic_init(&G->park[w].idle, 0);
+        G->park[w].sem = SDL_CreateSemaphore(0);
+        if (!G->park[w].sem)
+        {
+            tg_destroy(G);
+            return NULL;
+        }
+    }
+    atomic_init(&G->mainq.tail, 0);
+    for (int w = 1; w < nthreads; ++w)
+    {
+        WorkerArg *wa = (WorkerArg *)malloc(sizeof(WorkerArg));
+        if (!wa)
+            break;
+        wa->G = G;
+        wa->wid = w;
+        G->thr[w] = SDL_CreateThread(worker_main, "tg-worker", wa);
+        if (!G->thr[w])
+        {
+            free(wa);
+            G->nthreads = w; // sigue con los hilos que sí se crearon
+            break;
+        }
+    }
+    return G;
+}
+
+void tg_destroy(TaskGraph *G)
+{
+    if (!G)
+        return;
+    atomic_store(&G->quit, 1);
+    for (int w = 1; w < G->nthreads; ++w)
+        if (G->thr && G->thr[w])
+        {
+            SDL_SemPost(G->park[w].sem);
+            SDL_WaitThread(G->thr[w], NULL);
+        }
+    if (G->park)
+        for (int w = 0; w < G->nthreads; ++w)
+            if (G->park[w].sem)
+                SDL_DestroySemaphore(G->park[w].sem);
+    if (G->done)
+        SDL_DestroySemaphore(G->done);
+    if (G->dq)
+        for (int w = 0; w < G->nthreads; ++w)
+            free(G->dq[w].ids);
+    free(G->mainq.slot);
+    free(G->park);
+    free(G->dq);
+    free(G->thr);
+    free(G->tasks);
+    free(G->edge_from);
+    free(G->edge_to);
+    free(G->succ);
+    free(G);
+}
+
+int tg_num_threads(const TaskGraph *G) { return G->nthreads; }
+
+void tg_reset(TaskGraph *G)
+{
+    G->ntasks = 0;
+    G->nedges = 0;
+}
+
+int tg_add(TaskGraph *G, const char *name, TaskFn fn, void *ctx, long a, long b,
+           int flags, const int *deps, int ndeps)
+{
+    if (G->ntasks == G->cap)
+    {
+        int nc = G->cap ? G->cap * 2 : 256;
+        Task *nt = (Task *)realloc(G->tasks, (size_t)nc * sizeof(Task));
+        if (!nt)
+            return -1;
+        G->tasks = nt;
+        G->cap = nc;
+    }
+    if (G->nedges + ndeps > G->ecap)
+    {
+        int nc = G->ecap ? G->ecap : 1024;
+        while (nc < G->nedges + ndeps)
+            nc *= 2;
+        int *nf = (int *)realloc(G->edge_from, (size_t)nc * sizeof(int));
+        if (!nf)
+            return -1;
+        G->edge_from = nf;
+        int *nt = (int *)realloc(G->edge_to, (size_t)nc * sizeof(int));
+        if (!nt)
+            return -1;
+        G->edge_to = nt;
+        G->ecap = nc;
+    }
+    const int id = G->ntasks++;
+    Task *T = &G->tasks[id];
+    memset(T, 0, sizeof(*T));
+    T->name = name;
+    T->fn = fn;
+    T->ctx = ctx;
+    T->a = a;
+    T->b = b;
+    T->flags = flags;
+    for (int d = 0; d < ndeps; ++d)
+    {
+        if (deps[d] < 0 || deps[d] >= id)
+            continue;
+        G->edge_from[G->nedges] = deps[d];
+        G->edge_to[G->nedges] = id;
+        G->nedges++;
+        T->npred++;
+    }
+    return id;
+}
+
+// Sucesoras en formato CSR y deques con capacidad para todas las tareas
+static int prepare_run(TaskGraph *G)
+{
+    const int n = G->ntasks;
+    if (n > G->dq_cap)
+    {
+        for (int w = 0; w < G->nthreads; ++w)
+        {
+            atomic_int *ni = (atomic_int *)realloc(G->dq[w].ids, (size_t)n * sizeof(atomic_int));
+            if (!ni)
+                return 0;
+            G->dq[w].ids = ni;
+        }
+        atomic_int *nm = (atomic_int *)realloc(G->mainq.slot, (size_t)n * sizeof(atomic_int));
+        if (!nm)
+            return 0;
+        G->mainq.slot = nm;
+        for (int i = G->dq_cap; i < n; ++i)
+            atomic_init(&nm[i], 0);
+        G->dq_cap = n;
+    }
+    int *ns = (int *)realloc(G->succ, (size_t)(G->nedges > 0 ? G->nedges : 1) * sizeof(int));
+    if (!ns)
+        return 0;
+    G->succ = ns;
+
+    for (int i = 0; i < n; ++i)
+        G->tasks[i].nsucc = 0;
+    for (int e = 0; e < G->nedges; ++e)
+        G->tasks[G->edge_from[e]].nsucc++;
+    int acc = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        G->tasks[i].succ0 = acc;
+        acc += G->tasks[i].nsucc;
+        G->tasks[i].nsucc = 0;
+    }
+    for (int e = 0; e < G->nedges; ++e)
+    {
+        Task *F = &G->tasks[G->edge_from[e]];
+        G->succ[F->succ0 + F->nsucc++] = G->edge_to[e];
+    }
+    return 1;
+}
+
+void tg_run(TaskGraph *G)
+{
+    if (G->ntasks == 0)
+        return;
+    if (!prepare_run(G))
+    {
+        // Sin memoria para el plan: se ejecuta en orden de inserción (topológico)
+        for (int i = 0; i < G->ntasks; ++i)
+            G->tasks[i].fn(G->tasks[i].ctx, G->tasks[i].a, G->tasks[i].b);
+        return;
+    }
+
+    // Ningún trabajador toca las colas entre corridas
+    for (int w = 0; w < G->nthreads; ++w)
+    {
+        atomic_store_explicit(&G->dq[w].top, 0, memory_order_relaxed);
+        atomic_store_explicit(&G->dq[w].bottom, 0, memory_order_relaxed);
+    }
+    const int used = atomic_load_explicit(&G->mainq.tail, memory_order_relaxed);
+    for (int i = 0; i < used; ++i)
+        atomic_store_explicit(&G->mainq.slot[i], 0, memory_order_relaxed);
+    atomic_store_explicit(&G->mainq.tail, 0, memory_order_relaxed);
+    G->mainq.head = 0;
+
+    int rr = 0;
+    for (int i = 0; i < G->ntasks; ++i)
+    {
+        Task *T = &G->tasks[i];
+        atomic_store_explicit(&T->pending, T->npred, memory_order_relaxed);
+        if (T->npred == 0)
+        {
+            if (T->flags & TG_MAIN)
+                mq_push(&G->mainq, i);
+            else
+                dq_push(&G->dq[rr++ % G->nthreads], i);
+        }
+    }
+
+    G->run_t0 = SDL_GetPerformanceCounter();
+    atomic_store_explicit(&G->remaining, G->ntasks, memory_order_release);
+    // in_run se fija antes de despertar a nadie: cada trabajador lo baja al
+    // salir y el último postea 'done', así que un hilo que tarda en arrancar
+    // igual se cuenta (no hay ventana entre el post y su llegada).
+    atomic_store_explicit(&G->in_run, G->nthreads - 1, memory_order_release);
+    for (int w = 1; w < G->nthreads; ++w)
+        SDL_SemPost(G->park[w].sem);
+    worker_loop(G, 0);
+    // Ningún hilo puede seguir tocando el grafo cuando tg_run retorna
+    if (G->nthreads > 1)
+        SDL_SemWait(G->done);
+    G->run_t1 = SDL_GetPerformanceCounter();
+}
+
+void tg_last_stats(const TaskGraph *G, double *span_ms, double *idle_pct)
+{
+    const double freq = (double)SDL_GetPerformanceFrequency();
+    double span = (double)(G->run_t1 - G->run_t0) / freq;
+    double busy = 0.0;
+    for (int i = 0; i < G->ntasks; ++i)
+        busy += (double)(G->tasks[i].t1 - G->tasks[i].t0) / freq;
+    *span_ms = span * 1000.0;
+    *idle_pct = (span > 0.0) ? 100.0 * (1.0 - busy / (span * (double)G->nthreads)) : 0.0;
+    if (*idle_pct < 0.0)
+        *idle_pct = 0.0;
+}
+
+void tg_dump_csv(const TaskGraph *G, FILE *fp, long frame)
+{
+    const double us = 1e6 / (double)SDL_GetPerformanceFrequency();
+    for (int i = 0; i < G->ntasks; ++i)
+    {
+        const Task *T = &G->tasks[i];
+        fprintf(fp, "%ld,%d,%s,%d,%.1f,%.1f\n", frame, i, T->name, T->worker,
+                (double)(T->t0 - G->run_t0) * us, (double)(T->t1 - G->run_t0) * us);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <stdio.h>
+#include <SDL2/SDL.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Pool persistente de hilos que ejecuta cada frame como un grafo de
+    // tareas con dependencias. Cada hilo tiene su deque sin locks (LIFO para
+    // el dueño, FIFO para los ladrones); al terminar una tarea, las sucesoras
+    // que quedan listas se encolan en el hilo que la terminó. Los hilos sin
+    // trabajo duermen en un semáforo hasta que alguien encola. Las tareas
+    // TG_MAIN solo las ejecuta el hilo que llama a tg_run (el dueño del
+    // renderer SDL).
+    typedef struct TaskGraph TaskGraph;
+
+    // Tarea sobre un rango [a, b) o un índice de chunk (a)
+    typedef void (*TaskFn)(void *ctx, long a, long b);
+
+#define TG_MAIN 1 // solo el hilo principal puede ejecutarla
+
+    // nthreads incluye al hilo que llama a tg_run (se crean nthreads-1 hilos)
+    TaskGraph *tg_create(int nthreads);
+    void tg_destroy(TaskGraph *G);
+    int tg_num_threads(const TaskGraph *G);
+
+    // Comienza un grafo nuevo (descarta el anterior)
+    void tg_reset(TaskGraph *G);
+    // Agrega una tarea; deps son ids devueltos antes (se ignoran los < 0).
+    // Devuelve el id o -1 si no hay memoria.
+    int tg_add(TaskGraph *G, const char *name, TaskFn fn, void *ctx, long a, long b,
+               int flags, const int *deps, int ndeps);
+    // Ejecuta el grafo completo; el hilo llamador participa como trabajador 0.
+    void tg_run(TaskGraph *G);
+
+    // Estadísticas del último tg_run: tramo total y % de tiempo ocioso de los hilos
+    void tg_last_stats(const TaskGraph *G, double *span_ms, double *idle_pct);
+    // Vuelca las tareas del último tg_run como CSV (frame,tarea,nombre,hilo,inicio_us,fin_us)
+    void tg_dump_csv(const TaskGraph *G, FILE *fp, long frame);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,265 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define TRACE_BLOCK 16384     // eventos por bloque (~512 KB)
+#define TRACE_MAX_THREADS 256 // hilos distintos que pueden registrar tramos
+
+typedef struct
+{
+    const char *name;
+    Uint64 t0, t1;
+    long arg;
+} TraceEvent;
+
+// Bloque de eventos: el dueño escribe y publica 'count'/'next' con release,
+// así el volcado puede leer un prefijo consistente sin locks.
+typedef struct TraceBlock
+{
+    _Atomic(struct TraceBlock *) next;
+    atomic_int count;
+    TraceEvent ev[TRACE_BLOCK];
+} TraceBlock;
+
+typedef struct TraceBuf
+{
+    TraceBlock *head, *tail;
+    char name[32];
+    struct TraceBuf *retired; // siguiente en la lista de buffers ya cerrados
+} TraceBuf;
+
+atomic_int trace_on = 0;
+
+static char *g_path = NULL;
+static long g_f0 = 0, g_f1 = -1;
+static int g_dumped = 0;
+static Uint64 g_t0 = 0;
+// Cada slot se publica con release y el volcado lo lee con acquire
+static _Atomic(TraceBuf *) g_bufs[TRACE_MAX_THREADS];
+static atomic_int g_nbufs = 0;
+static atomic_int g_open = 0;
+// trace_close sube la generación: los hilos descartan su tl_buf viejo en el
+// próximo tramo. Los buffers cerrados no se liberan hasta la salida del
+// proceso, porque un hilo puede estar terminando un tramo sobre el suyo.
+static atomic_int g_gen = 0;
+static TraceBuf *g_retired = NULL;
+static _Thread_local TraceBuf *tl_buf = NULL;
+static _Thread_local int tl_full = 0; // sin espacio: el hilo deja de trazar
+static _Thread_local int tl_gen = 0;
+
+static TraceBlock *new_block(void)
+{
+    TraceBlock *b = (TraceBlock *)malloc(sizeof(TraceBlock));
+    if (b)
+    {
+        atomic_init(&b->next, NULL);
+        atomic_init(&b->count, 0);
+    }
+    return b;
+}
+
+// Registra el buffer del hilo llamador la primera vez que traza
+static TraceBuf *thread_buf(void)
+{
+    const int gen = atomic_load_explicit(&g_gen, memory_order_acquire);
+    if (tl_gen != gen)
+    {
+        tl_buf = NULL;
+        tl_full = 0;
+        tl_gen = gen;
+    }
+    if (tl_buf || tl_full)
+        return tl_buf;
+    if (!atomic_load_explicit(&g_open, memory_order_acquire))
+        return NULL;
+    int slot = atomic_fetch_add(&g_nbufs, 1);
+    TraceBuf *B = (slot < TRACE_MAX_THREADS) ? (TraceBuf *)calloc(1, sizeof(TraceBuf)) : NULL;
+    TraceBlock *blk = B ? new_block() : NULL;
+    if (!blk)
+    {
+        free(B);
+        tl_full = 1;
+        if (slot >= TRACE_MAX_THREADS)
+            atomic_fetch_sub(&g_nbufs, 1);
+        return NULL;
+    }
+    B->head = B->tail = blk;
+#ifdef _OPENMP
+    if (omp_in_parallel())
+        snprintf(B->name, sizeof(B->name), "omp %d", omp_get_thread_num());
+    else
+#endif
+        snprintf(B->name, sizeof(B->name), "hilo %d", slot);
+    atomic_store_explicit(&g_bufs[slot], B, memory_order_release);
+    tl_buf = B;
+    return B;
+}
+
+int trace_open(const char *path, long frame0, long frame1)
+{
+    FILE *fp = fopen(path, "w"); // falla temprano si la ruta no sirve
+    if (!fp)
+    {
+        fprintf(stderr, "trace: no se pudo abrir %s\n", path);
+        return 0;
+    }
+    fclose(fp);
+    g_path = (char *)malloc(strlen(path) + 1);
+    if (!g_path)
+        return 0;
+    strcpy(g_path, path);
+    g_f0 = frame0 > 0 ? frame0 : 0;
+    g_f1 = frame1;
+    g_dumped = 0;
+    g_t0 = SDL_GetPerformanceCounter();
+    atomic_store(&g_nbufs, 0);
+    atomic_store_explicit(&g_open, 1, memory_order_release);
+    trace_thread_name("main");
+    return 1;
+}
+
+void trace_thread_name(const char *name)
+{
+    TraceBuf *B = thread_buf(); // NULL si el trazador no está abierto
+    if (B)
+        snprintf(B->name, sizeof(B->name), "%s", name);
+}
+
+TraceSpan trace_begin_slow(const char *name)
+{
+    TraceSpan sp = {name, SDL_GetPerformanceCounter()};
+    return sp;
+}
+
+void trace_end_slow(TraceSpan sp, long arg)
+{
+    const Uint64 t1 = SDL_GetPerformanceCounter();
+    TraceBuf *B = thread_buf();
+    if (!B)
+        return;
+    TraceBlock *blk = B->tail;
+    int n = atomic_load_explicit(&blk->count, memory_order_relaxed);
+    if (n == TRACE_BLOCK)
+    {
+        TraceBlock *nb = new_block();
+        if (!nb)
+            return;
+        atomic_store_explicit(&blk->next, nb, memory_order_release);
+        B->tail = blk = nb;
+        n = 0;
+    }
+    TraceEvent *e = &blk->ev[n];
+    e->name = sp.name;
+    e->t0 = sp.t0;
+    e->t1 = t1;
+    e->arg = arg;
+    atomic_store_explicit(&blk->count, n + 1, memory_order_release);
+}
+
+static void dump(void)
+{
+    FILE *fp = fopen(g_path, "w");
+    if (!fp)
+    {
+        fprintf(stderr, "trace: no se pudo escribir %s\n", g_path);
+        return;
+    }
+    const double us = 1e6 / (double)SDL_GetPerformanceFrequency();
+    long nev = 0;
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"screensaver\"}}");
+    int nb = atomic_load(&g_nbufs);
+    if (nb > TRACE_MAX_THREADS)
+        nb = TRACE_MAX_THREADS;
+    for (int t = 0; t < nb; ++t)
+    {
+        const TraceBuf *B = atomic_load_explicit(&g_bufs[t], memory_order_acquire);
+        if (!B)
+            continue;
+        fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                t, B->name);
+        fprintf(fp, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+                t, t);
+        for (const TraceBlock *blk = B->head; blk; blk = atomic_load_explicit(&blk->next, memory_order_acquire))
+        {
+            const int n = atomic_load_explicit(&blk->count, memory_order_acquire);
+            for (int k = 0; k < n; ++k)
+            {
+                const TraceEvent *e = &blk->ev[k];
+                fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                        e->name, t, (double)(e->t0 - g_t0) * us, (double)(e->t1 - e->t0) * us);
+                if (e->arg >= 0)
+                    fprintf(fp, ",\"args\":{\"v\":%ld}", e->arg);
+                fputc('}', fp);
+                nev++;
+            }
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    printf("trace: %ld tramos de %d hilos en %s\n", nev, nb, g_path);
+}
+
+void trace_frame(long frame)
+{
+    if (!g_path || g_dumped)
+        return;
+    const int want = frame >= g_f0 && (g_f1 < 0 || frame <= g_f1);
+    atomic_store_explicit(&trace_on, want, memory_order_relaxed);
+    // Ventana terminada: se vuelca ya (los demás hilos están entre frames)
+    if (g_f1 >= 0 && frame > g_f1)
+    {
+        dump();
+        g_dumped = 1;
+    }
+}
+
+static void free_retired(void)
+{
+    while (g_retired)
+    {
+        TraceBuf *B = g_retired;
+        g_retired = B->retired;
+        TraceBlock *blk = B->head;
+        while (blk)
+        {
+            TraceBlock *nx = atomic_load(&blk->next);
+            free(blk);
+            blk = nx;
+        }
+        free(B);
+    }
+}
+
+void trace_close(void)
+{
+    if (!g_path)
+        return;
+    atomic_store(&trace_on, 0);
+    atomic_store(&g_open, 0);
+    if (!g_dumped)
+        dump();
+    // Nueva generación: ningún hilo vuelve a usar su buffer de esta sesión
+    atomic_fetch_add_explicit(&g_gen, 1, memory_order_release);
+    static int atexit_done = 0;
+    if (!atexit_done)
+        atexit_done = (atexit(free_retired) == 0);
+    int nb = atomic_load(&g_nbufs);
+    if (nb > TRACE_MAX_THREADS)
+        nb = TRACE_MAX_THREADS;
+    for (int t = 0; t < nb; ++t)
+    {
+        TraceBuf *B = atomic_exchange_explicit(&g_bufs[t], NULL, memory_order_acq_rel);
+        if (!B)
+            continue;
+        B->retired = g_retired;
+        g_retired = B;
+    }
+    free(g_path);
+    g_path = NULL;
+}
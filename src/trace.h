@@ -0,0 +1,58 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <SDL2/SDL.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Trazador opcional (--trace): tramos inicio/fin por hilo que se exportan
+    // como JSON de Chrome trace-event (chrome://tracing, ui.perfetto.dev).
+    // Cada hilo escribe en su propio buffer por bloques (un solo escritor, sin
+    // locks); el JSON se vuelca al cerrar o al terminar la ventana de frames.
+    typedef struct
+    {
+        const char *name; // literal: se guarda el puntero, no se copia
+        Uint64 t0;        // 0 = no se registra (trazador inactivo)
+    } TraceSpan;
+
+    // frame1 < 0 = hasta el final. Devuelve 0 si no pudo abrir el archivo.
+    int trace_open(const char *path, long frame0, long frame1);
+    // Llamar al inicio de cada frame desde el hilo principal: activa/desactiva
+    // la captura según la ventana y vuelca el archivo al salir de ella.
+    void trace_frame(long frame);
+    // Nombre del hilo llamador en la vista de trazas
+    void trace_thread_name(const char *name);
+    void trace_close(void);
+
+    extern atomic_int trace_on; // lectura rápida en los puntos de traza
+
+    TraceSpan trace_begin_slow(const char *name);
+    void trace_end_slow(TraceSpan sp, long arg);
+
+    static inline TraceSpan trace_begin(const char *name)
+    {
+        TraceSpan sp = {name, 0};
+        if (atomic_load_explicit(&trace_on, memory_order_relaxed))
+            sp = trace_begin_slow(name);
+        return sp;
+    }
+    static inline void trace_end(TraceSpan sp)
+    {
+        if (sp.t0)
+            trace_end_slow(sp, -1);
+    }
+    // Igual que trace_end, con un argumento entero visible en el visor (p. ej. frame)
+    static inline void trace_end_arg(TraceSpan sp, long arg)
+    {
+        if (sp.t0)
+            trace_end_slow(sp, arg);
+    }
+
+#ifdef __cplusplus
+}
+#endif
+#endif